@@ -5,6 +5,7 @@
 #define luaall_c
 
 #include "lapi.c"
+#include "larray.c"
 #include "lcode.c"
 #include "ldebug.c"
 #include "ldo.c"
@@ -20,12 +21,16 @@
 #include "lstring.c"
 #include "ltable.c"
 #include "ltm.c"
+#include "ltrace.c"
 #include "lundump.c"
 #include "lvm.c"
 #include "lzio.c"
 
+#include "larraylib.c"
 #include "lauxlib.c"
 #include "lbaselib.c"
+#include "lbitlib.c"
+#include "lbuflib.c"
 #include "ldblib.c"
 #include "liolib.c"
 #include "linit.c"
@@ -16,6 +16,7 @@
 #include "lua.h"
 
 #include "lapi.h"
+#include "larray.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
@@ -26,6 +27,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "ltrace.h"
 #include "lundump.h"
 #include "lvm.h"
 
@@ -390,7 +392,9 @@ LUA_API size_t lua_objlen (lua_State *L, int idx) {
   StkId o = index2adr(L, idx);
   switch (ttype(o)) {
     case LUA_TSTRING: return tsvalue(o)->len;
-    case LUA_TUSERDATA: return uvalue(o)->len;
+    case LUA_TUSERDATA:  /* a typed array has its number of elements */
+      return istarray(o) ? cast(size_t, tarrayof(rawuvalue(o))->a.size)
+                         : uvalue(o)->len;
     case LUA_TTABLE: return luaH_getn(hvalue(o));
     case LUA_TNUMBER: {
       size_t l;
@@ -422,6 +426,19 @@ LUA_API void *lua_touserdata (lua_State *L, int idx) {
 }
 
 
+/*
+** elements of a typed array, without copying; NULL if the value is not
+** one. The pointer stays valid while the array is alive.
+*/
+LUA_API void *lua_totypedarray (lua_State *L, int idx, int *kind, int *n) {
+  StkId o = index2adr(L, idx);
+  if (!istarray(o)) return NULL;
+  if (kind) *kind = tarrayof(rawuvalue(o))->a.kind;
+  if (n) *n = tarrayof(rawuvalue(o))->a.size;
+  return tarraydata(rawuvalue(o));
+}
+
+
 LUA_API lua_State *lua_tothread (lua_State *L, int idx) {
   StkId o = index2adr(L, idx);
   return (!ttisthread(o)) ? NULL : thvalue(o);
@@ -459,6 +476,7 @@ LUA_API void lua_pushnil (lua_State *L) {
 LUA_API void lua_pushnumber (lua_State *L, lua_Number n) {
   lua_lock(L);
   setnvalue(L->top, n);
+  canonnan(L->top);
   api_incr_top(L);
   lua_unlock(L);
 }
@@ -481,6 +499,22 @@ LUA_API void lua_pushlstring (lua_State *L, const char *s, size_t len) {
 }
 
 
+/*
+** pushes a string that uses the caller's buffer `s' (with `s[len]' ==
+** '\0') with no copy; `freef' releases it (see `luaS_newext'). If this
+** raises an error (out of memory), `s' still belongs to the caller.
+*/
+LUA_API void lua_pushexternalstring (lua_State *L, const char *s, size_t len,
+                                     lua_Alloc freef, void *ud) {
+  lua_lock(L);
+  api_check(L, s[len] == '\0');
+  luaC_checkGC(L);
+  setsvalue2s(L, L->top, luaS_newext(L, s, len, freef, ud));
+  api_incr_top(L);
+  lua_unlock(L);
+}
+
+
 LUA_API void lua_pushstring (lua_State *L, const char *s) {
   if (s == NULL)
     lua_pushnil(L);
@@ -812,6 +846,55 @@ LUA_API int lua_setfenv (lua_State *L, int idx) {
 }
 
 
+LUA_API void lua_cleartable (lua_State *L, int idx) {
+  StkId t;
+  lua_lock(L);
+  t = index2adr(L, idx);
+  api_check(L, ttistable(t));
+  luaH_clear(L, hvalue(t));
+  lua_unlock(L);
+}
+
+
+/*
+** raw copy of elements f..e of the table at `idx1' to positions t.. of
+** the table at `idx2' (see `luaH_move')
+*/
+LUA_API void lua_rawmove (lua_State *L, int idx1, int f, int e, int t,
+                                        int idx2) {
+  StkId a1, a2;
+  lua_lock(L);
+  a1 = index2adr(L, idx1);
+  a2 = index2adr(L, idx2);
+  api_check(L, ttistable(a1) && ttistable(a2));
+  luaH_move(L, hvalue(a1), f, e, t, hvalue(a2));
+  lua_unlock(L);
+}
+
+
+/*
+** declares that `f' behaves as the primitive `next' (called with a table
+** and a key, it returns the same as `lua_next', or a single nil); the
+** interpreter then runs generic for loops driven by `f' without calling
+** it (see OP_TFORLOOP)
+*/
+LUA_API void lua_setnextfunction (lua_State *L, lua_CFunction f) {
+  lua_lock(L);
+  G(L)->nextf = f;
+  lua_unlock(L);
+}
+
+
+LUA_API void lua_freezetable (lua_State *L, int idx) {
+  StkId t;
+  lua_lock(L);
+  t = index2adr(L, idx);
+  api_check(L, ttistable(t));
+  luaH_freeze(L, hvalue(t));
+  lua_unlock(L);
+}
+
+
 /*
 ** `load' and `call' functions (run Lua code)
 */
@@ -892,9 +975,9 @@ struct CCallS {  /* data to `f_Ccall' */
 ** c.ud = Smain
 */
 static void f_Ccall (lua_State *L, void *ud) {
-  printf("debug: in f_Ccall\n");
   struct CCallS *c = cast(struct CCallS *, ud);
   Closure *cl;
+  luaR_trace(L, LUA_TRACEPCALL, "f_Ccall", 0, 0);
   cl = luaF_newCclosure(L, 0, getcurrenv(L));
   cl->c.f = c->func;
   /*
@@ -919,10 +1002,10 @@ static void f_Ccall (lua_State *L, void *ud) {
 ** lua_cpcall(L, &pmain, &Smain);
 */
 LUA_API int lua_cpcall (lua_State *L, lua_CFunction func, void *ud) {
-  printf("debug: in lua_cpcall\n");
   struct CCallS c;
   int status;
   lua_lock(L);
+  luaR_trace(L, LUA_TRACEPCALL, "cpcall", 0, 0);
   c.func = func; /* pmain */
   c.ud = ud; /* Smain */
   status = luaD_pcall(L, f_Ccall, &c, savestack(L, L->top), 0); /* sizeof(TValue) = 16 */
@@ -1094,6 +1177,23 @@ LUA_API void lua_setallocf (lua_State *L, lua_Alloc f, void *ud) {
 }
 
 
+/*
+** counts a block that the caller got from the state's allocator, and
+** that changed from `osize' to `nsize' bytes, as memory in use by Lua,
+** so that it paces the collector (which may run a step here)
+*/
+LUA_API void lua_accountmem (lua_State *L, size_t osize, size_t nsize) {
+  global_State *g;
+  lua_lock(L);
+  g = G(L);
+  api_check(L, osize <= g->totalbytes);
+  g->totalbytes = (g->totalbytes - osize) + nsize;
+  if (nsize > osize)
+    luaC_checkGC(L);
+  lua_unlock(L);
+}
+
+
 LUA_API void *lua_newuserdata (lua_State *L, size_t size) {
   Udata *u;
   lua_lock(L);
@@ -1106,6 +1206,19 @@ LUA_API void *lua_newuserdata (lua_State *L, size_t size) {
 }
 
 
+LUA_API void *lua_newtypedarray (lua_State *L, int kind, int n) {
+  Udata *u;
+  lua_lock(L);
+  api_check(L, LUA_ADOUBLE <= kind && kind <= LUA_AUINT8 && n >= 0);
+  luaC_checkGC(L);
+  u = luaN_new(L, kind, n, getcurrenv(L));
+  setuvalue(L, L->top, u);
+  api_incr_top(L);
+  lua_unlock(L);
+  return tarraydata(u);
+}
+
+
 
 
 static const char *aux_upvalue (StkId fi, int n, TValue **val) {
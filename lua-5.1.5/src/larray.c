@@ -0,0 +1,119 @@
+/*
+** $Id: larray.c $
+** Typed arrays (unboxed numbers stored in a userdata)
+** See Copyright Notice in lua.h
+*/
+
+
+#include <string.h>
+
+#define larray_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "larray.h"
+#include "lmem.h"
+#include "lobject.h"
+#include "lstate.h"
+#include "lstring.h"
+
+
+static const size_t elemsize[] = {
+  sizeof(double),  /* LUA_ADOUBLE */
+  sizeof(LUAI_INT32),  /* LUA_AINT32 */
+  sizeof(unsigned char)  /* LUA_AUINT8 */
+};
+
+
+/*
+** create a typed array with `n' elements, all zero; the caller must
+** check that `kind' is valid
+*/
+Udata *luaN_new (lua_State *L, int kind, int n, Table *e) {
+  Udata *u;
+  TArray *a;
+  size_t es = elemsize[kind];
+  if (cast(size_t, n) > (MAX_SIZET - sizeof(TArray)) / es)
+    luaM_toobig(L);
+  u = luaS_newudata(L, sizeof(TArray) + n*es, e);
+  u->uv.metatable = G(L)->tamt;
+  u->uv.istarray = 1;
+  a = tarrayof(u);
+  a->a.kind = kind;
+  a->a.size = n;
+  memset(tarraydata(u), 0, n*es);
+  return u;
+}
+
+
+/*
+** converts `key' to an index into the elements of `u'; returns -1 if
+** it is not an integer in [1, size]
+*/
+static int arrayindex (Udata *u, const TValue *key) {
+  if (ttisnumber(key)) {
+    lua_Number n = nvalue(key);
+    int k;
+    lua_number2int(k, n);
+    if (luai_numeq(cast_num(k), n) &&
+        cast(unsigned int, k-1) < cast(unsigned int, tarrayof(u)->a.size))
+      return k-1;
+  }
+  return -1;
+}
+
+
+/*
+** u[key] into `res'; returns 0 (and leaves `res' untouched) when `key'
+** is not a valid index
+*/
+int luaN_get (Udata *u, const TValue *key, StkId res) {
+  int k = arrayindex(u, key);
+  if (k < 0) return 0;
+  switch (tarrayof(u)->a.kind) {
+    case LUA_ADOUBLE:  /* C code may have stored any NaN there */
+      setnvalue(res, cast_num(cast(double *, tarraydata(u))[k]));
+      canonnan(res);
+      break;
+    case LUA_AINT32:
+      setnvalue(res, cast_num(cast(LUAI_INT32 *, tarraydata(u))[k]));
+      break;
+    default:
+      setnvalue(res, cast_num(cast(unsigned char *, tarraydata(u))[k]));
+      break;
+  }
+  return 1;
+}
+
+
+/*
+** u[key] = val; returns 0 (and changes nothing) when `key' is not a valid
+** index or `val' is not a number. Integer kinds truncate the value as
+** `lua_number2int' does; uint8 keeps its low 8 bits.
+*/
+int luaN_set (Udata *u, const TValue *key, const TValue *val) {
+  int k = arrayindex(u, key);
+  if (k < 0 || !ttisnumber(val)) return 0;
+  switch (tarrayof(u)->a.kind) {
+    case LUA_ADOUBLE:
+      cast(double *, tarraydata(u))[k] = cast(double, nvalue(val));
+      break;
+    case LUA_AINT32: {
+      int v;
+      lua_Number n = nvalue(val);
+      lua_number2int(v, n);
+      cast(LUAI_INT32 *, tarraydata(u))[k] = cast(LUAI_INT32, v);
+      break;
+    }
+    default: {
+      int v;
+      lua_Number n = nvalue(val);
+      lua_number2int(v, n);
+      cast(unsigned char *, tarraydata(u))[k] = cast(unsigned char, v & 0xff);
+      break;
+    }
+  }
+  return 1;
+}
+
@@ -0,0 +1,42 @@
+/*
+** $Id: larray.h $
+** Typed arrays (unboxed numbers stored in a userdata)
+** See Copyright Notice in lua.h
+*/
+
+#ifndef larray_h
+#define larray_h
+
+
+#include "lobject.h"
+#include "lstate.h"
+
+
+/*
+** header of a typed array; the elements follow it in the same userdata
+*/
+typedef union TArray {
+  L_Umaxalign dummy;  /* ensures maximum alignment for the elements */
+  struct {
+    int kind;  /* LUA_ADOUBLE, LUA_AINT32 or LUA_AUINT8 */
+    int size;  /* number of elements */
+  } a;
+} TArray;
+
+
+#define tarrayof(u)	cast(TArray *, (u) + 1)
+#define tarraydata(u)	cast(void *, tarrayof(u) + 1)
+
+/*
+** typed arrays are marked in their Udata: their shared metatable
+** `G(L)->tamt' could be given to other userdata by debug.setmetatable
+*/
+#define istarray(o)	(ttisuserdata(o) && uvalue(o)->istarray)
+
+
+LUAI_FUNC Udata *luaN_new (lua_State *L, int kind, int n, Table *e);
+LUAI_FUNC int luaN_get (Udata *u, const TValue *key, StkId res);
+LUAI_FUNC int luaN_set (Udata *u, const TValue *key, const TValue *val);
+
+
+#endif
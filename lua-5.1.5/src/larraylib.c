@@ -0,0 +1,187 @@
+/*
+** $Id: larraylib.c $
+** Library for typed arrays
+** See Copyright Notice in lua.h
+*/
+
+
+#define larraylib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** The interpreter reads, writes and takes the length of valid indices
+** itself; the metamethods below only run for the other cases (and for
+** accesses through the API).
+*/
+
+static const char *const kindnames[] = {"double", "int32", "uint8", NULL};
+
+
+static void *checkarray (lua_State *L, int narg, int *kind, int *n) {
+  void *p = lua_totypedarray(L, narg, kind, n);
+  if (p == NULL) luaL_typerror(L, narg, "array");
+  return p;
+}
+
+
+static lua_Number getelem (void *p, int kind, int k) {
+  switch (kind) {
+    case LUA_ADOUBLE: return (lua_Number)((double *)p)[k];
+    case LUA_AINT32: return (lua_Number)((LUAI_INT32 *)p)[k];
+    default: return (lua_Number)((unsigned char *)p)[k];
+  }
+}
+
+
+static void setelem (void *p, int kind, int k, lua_Number v) {
+  switch (kind) {
+    case LUA_ADOUBLE: ((double *)p)[k] = (double)v; break;
+    case LUA_AINT32: {
+      int i;
+      lua_number2int(i, v);
+      ((LUAI_INT32 *)p)[k] = (LUAI_INT32)i;
+      break;
+    }
+    default: {
+      int i;
+      lua_number2int(i, v);
+      ((unsigned char *)p)[k] = (unsigned char)(i & 0xff);
+      break;
+    }
+  }
+}
+
+
+/* index of key at `narg' in [0, n), or -1 */
+static int toindex (lua_State *L, int narg, int n) {
+  if (lua_type(L, narg) == LUA_TNUMBER) {
+    lua_Number d = lua_tonumber(L, narg);
+    int k;
+    lua_number2int(k, d);
+    if ((lua_Number)k == d && 1 <= k && k <= n)
+      return k - 1;
+  }
+  return -1;
+}
+
+
+static int anew (lua_State *L) {
+  int n = luaL_checkint(L, 1);
+  int kind = luaL_checkoption(L, 2, "double", kindnames);
+  luaL_argcheck(L, n >= 0, 1, "negative size");
+  lua_newtypedarray(L, kind, n);
+  return 1;
+}
+
+
+static int afrom (lua_State *L) {
+  int i, n;
+  int kind = luaL_checkoption(L, 2, "double", kindnames);
+  void *p;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  n = luaL_getn(L, 1);
+  p = lua_newtypedarray(L, kind, n);
+  for (i = 1; i <= n; i++) {
+    lua_rawgeti(L, 1, i);
+    if (lua_type(L, -1) != LUA_TNUMBER)
+      return luaL_error(L, "invalid value (at index %d) in table for "
+                           LUA_QL("from"), i);
+    setelem(p, kind, i - 1, lua_tonumber(L, -1));
+    lua_pop(L, 1);
+  }
+  return 1;
+}
+
+
+static int akind (lua_State *L) {
+  int k;
+  checkarray(L, 1, &k, NULL);
+  lua_pushstring(L, kindnames[k]);
+  return 1;
+}
+
+
+static int atotable (lua_State *L) {
+  int i, k, n;
+  void *p = checkarray(L, 1, &k, &n);
+  lua_createtable(L, n, 0);
+  for (i = 0; i < n; i++) {
+    lua_pushnumber(L, getelem(p, k, i));
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
+
+static int aindex (lua_State *L) {
+  int k, n, i;
+  void *p = checkarray(L, 1, &k, &n);
+  i = toindex(L, 2, n);
+  if (i < 0) lua_pushnil(L);
+  else lua_pushnumber(L, getelem(p, k, i));
+  return 1;
+}
+
+
+static int anewindex (lua_State *L) {
+  int k, n, i;
+  void *p = checkarray(L, 1, &k, &n);
+  i = toindex(L, 2, n);
+  luaL_argcheck(L, i >= 0, 2, "index out of range");
+  setelem(p, k, i, luaL_checknumber(L, 3));
+  return 0;
+}
+
+
+static int alen (lua_State *L) {
+  int n;
+  checkarray(L, 1, NULL, &n);
+  lua_pushinteger(L, n);
+  return 1;
+}
+
+
+static int atostring (lua_State *L) {
+  int k, n;
+  void *p = checkarray(L, 1, &k, &n);
+  lua_pushfstring(L, "array<%s>[%d]: %p", kindnames[k], n, p);
+  return 1;
+}
+
+
+static const luaL_Reg array_funcs[] = {
+  {"from", afrom},
+  {"kind", akind},
+  {"new", anew},
+  {"totable", atotable},
+  {NULL, NULL}
+};
+
+
+static const luaL_Reg array_meta[] = {
+  {"__index", aindex},
+  {"__len", alen},
+  {"__newindex", anewindex},
+  {"__tostring", atostring},
+  {NULL, NULL}
+};
+
+
+LUALIB_API int luaopen_array (lua_State *L) {
+  luaL_register(L, LUA_ARRAYLIBNAME, array_funcs);
+  /* all arrays share one metatable; get it from an empty array */
+  lua_newtypedarray(L, LUA_ADOUBLE, 0);
+  lua_getmetatable(L, -1);
+  luaL_register(L, NULL, array_meta);
+  lua_pushliteral(L, "array");
+  lua_setfield(L, -2, "__metatable");  /* hide it from Lua code */
+  lua_pop(L, 2);
+  return 1;
+}
+
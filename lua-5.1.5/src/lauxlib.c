@@ -300,9 +300,9 @@ static const luaL_Reg pk_funcs[] = {
 */
 LUALIB_API void luaI_openlib (lua_State *L, const char *libname,
                               const luaL_Reg *l, int nup) {
-  printf("debug: ***** libname = %s\n", libname);
   if (libname) {
     int size = libsize(l);
+    luai_apitrace(L, LUA_TRACELIBOPEN, libname, size, nup);
     /* check whether lib already exists */
     luaL_findtable(L, LUA_REGISTRYINDEX, "_LOADED", 1); //该函数执行完，栈顶元素为l_registry["_LOADED"]的值（是一个表结构）
     lua_getfield(L, -1, libname);  /* get _LOADED[libname] */
@@ -642,6 +642,7 @@ static void base_open (lua_State *L) {
   /* `ipairs' and `pairs' need auxiliary functions as upvalues */
   auxopen(L, "ipairs", luaB_ipairs, ipairsaux);
   auxopen(L, "pairs", luaB_pairs, luaB_next);
+  lua_setnextfunction(L, luaB_next);  /* let `for' run it inline */
   /* `newproxy' needs a weaktable as upvalue */
   lua_createtable(L, 0, 1);  /* new table `w' */
   lua_pushvalue(L, -1);  /* `w' will be its own metatable */
@@ -654,7 +655,6 @@ static void base_open (lua_State *L) {
 
 
 LUALIB_API int luaopen_base (lua_State *L) {
-  printf("debug: 1.luaopen_base\n");
   base_open(L);
   luaL_register(L, LUA_COLIBNAME, co_funcs);
   return 2;
@@ -0,0 +1,177 @@
+/*
+** $Id: lbitlib.c $
+** Bitwise operations library
+** See Copyright Notice in lua.h
+*/
+
+
+#include <math.h>
+
+#define lbitlib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** Operations work on 32-bit integers and return them as signed numbers
+** (the same interface as the LuaBitOp `bit' module). Arguments are taken
+** modulo 2^32 after rounding down, so any number is a valid argument;
+** NaN and infinities give 0.
+*/
+typedef LUAI_UINT32 UBits;
+
+#define TWO32	4294967296.0
+
+
+static UBits checkbits (lua_State *L, int narg) {
+  lua_Number n = luaL_checknumber(L, narg);
+  if (n >= 0 && n < TWO32)
+    return (UBits)n;
+  if (n - n != 0)  /* NaN or infinity? */
+    return 0;
+  n = fmod(floor(n), TWO32);
+  if (n < 0) n += TWO32;
+  return (UBits)n;
+}
+
+
+static int pushbits (lua_State *L, UBits b) {
+  b &= 0xffffffff;
+  if (b & 0x80000000)
+    lua_pushnumber(L, (lua_Number)b - TWO32);
+  else
+    lua_pushnumber(L, (lua_Number)b);
+  return 1;
+}
+
+
+static int bit_tobit (lua_State *L) {
+  return pushbits(L, checkbits(L, 1));
+}
+
+
+static int bit_bnot (lua_State *L) {
+  return pushbits(L, ~checkbits(L, 1));
+}
+
+
+static int bit_band (lua_State *L) {
+  int i, n = lua_gettop(L);
+  UBits b = checkbits(L, 1);
+  for (i = 2; i <= n; i++) b &= checkbits(L, i);
+  return pushbits(L, b);
+}
+
+
+static int bit_bor (lua_State *L) {
+  int i, n = lua_gettop(L);
+  UBits b = checkbits(L, 1);
+  for (i = 2; i <= n; i++) b |= checkbits(L, i);
+  return pushbits(L, b);
+}
+
+
+static int bit_bxor (lua_State *L) {
+  int i, n = lua_gettop(L);
+  UBits b = checkbits(L, 1);
+  for (i = 2; i <= n; i++) b ^= checkbits(L, i);
+  return pushbits(L, b);
+}
+
+
+static int bit_lshift (lua_State *L) {
+  UBits b = checkbits(L, 1);
+  return pushbits(L, b << (checkbits(L, 2) & 31));
+}
+
+
+static int bit_rshift (lua_State *L) {
+  UBits b = checkbits(L, 1) & 0xffffffff;
+  return pushbits(L, b >> (checkbits(L, 2) & 31));
+}
+
+
+static int bit_arshift (lua_State *L) {
+  UBits b = checkbits(L, 1) & 0xffffffff;
+  int n = (int)(checkbits(L, 2) & 31);
+  if (n > 0 && (b & 0x80000000))
+    b = (b >> n) | ~(0xffffffff >> n);  /* fill with the sign bit */
+  else
+    b >>= n;
+  return pushbits(L, b);
+}
+
+
+static int bit_rol (lua_State *L) {
+  UBits b = checkbits(L, 1) & 0xffffffff;
+  int n = (int)(checkbits(L, 2) & 31);
+  return pushbits(L, n ? (b << n) | (b >> (32 - n)) : b);
+}
+
+
+static int bit_ror (lua_State *L) {
+  UBits b = checkbits(L, 1) & 0xffffffff;
+  int n = (int)(checkbits(L, 2) & 31);
+  return pushbits(L, n ? (b >> n) | (b << (32 - n)) : b);
+}
+
+
+static int bit_bswap (lua_State *L) {
+  UBits b = checkbits(L, 1);
+  b = (b >> 24) | ((b >> 8) & 0xff00) | ((b & 0xff00) << 8) | (b << 24);
+  return pushbits(L, b);
+}
+
+
+/*
+** tohex(x [, n]): the |n| (default 8) low hexadecimal digits of `x';
+** upper case if `n' is negative
+*/
+static int bit_tohex (lua_State *L) {
+  UBits b = checkbits(L, 1) & 0xffffffff;
+  lua_Number m = luaL_optnumber(L, 2, 8);
+  const char *digits = "0123456789abcdef";
+  char buf[8];
+  int i, n;
+  if (!(m >= -8)) m = -8;  /* clamp before converting (also NaN) */
+  else if (m > 8) m = 8;
+  n = (int)m;
+  if (n < 0) { n = -n; digits = "0123456789ABCDEF"; }
+  for (i = n - 1; i >= 0; i--) {
+    buf[i] = digits[b & 15];
+    b >>= 4;
+  }
+  lua_pushlstring(L, buf, (size_t)n);
+  return 1;
+}
+
+
+static const luaL_Reg bitlib[] = {
+  {"arshift", bit_arshift},
+  {"band",    bit_band},
+  {"bnot",    bit_bnot},
+  {"bor",     bit_bor},
+  {"bswap",   bit_bswap},
+  {"bxor",    bit_bxor},
+  {"lshift",  bit_lshift},
+  {"rol",     bit_rol},
+  {"ror",     bit_ror},
+  {"rshift",  bit_rshift},
+  {"tobit",   bit_tobit},
+  {"tohex",   bit_tohex},
+  {NULL, NULL}
+};
+
+
+/*
+** Open bit library
+*/
+LUALIB_API int luaopen_bit (lua_State *L) {
+  luaL_register(L, LUA_BITLIBNAME, bitlib);
+  return 1;
+}
+
@@ -0,0 +1,235 @@
+/*
+** $Id: lbuflib.c $
+** String buffers
+** See Copyright Notice in lua.h
+*/
+
+
+#include <string.h>
+
+#define lbuflib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** A string buffer keeps its contents in a single block from the state's
+** allocator, which doubles when it fills up and always has room for a
+** final '\0', and which the collector counts (see lua_accountmem).
+** `tostring' empties the buffer; when the result is a long string it gets
+** the block itself (see lua_pushexternalstring, which then counts it), so
+** the contents are not copied again.
+*/
+
+#define STRBUF		"strbuf"
+
+#define MINSIZE		64
+#define MAXSIZE		(~(size_t)0)
+
+
+typedef struct StrBuf {
+  char *b;
+  size_t n;  /* number of characters in use */
+  size_t size;  /* size of block `b' (0 if none) */
+} StrBuf;
+
+
+#define tobuf(L)	((StrBuf *)luaL_checkudata(L, 1, STRBUF))
+
+
+/* the buffer at index `i', or NULL if there is none */
+static StrBuf *testbuf (lua_State *L, int i) {
+  StrBuf *p = (StrBuf *)lua_touserdata(L, i);
+  if (p != NULL && lua_getmetatable(L, i)) {
+    lua_getfield(L, LUA_REGISTRYINDEX, STRBUF);
+    if (!lua_rawequal(L, -1, -2)) p = NULL;
+    lua_pop(L, 2);
+    return p;
+  }
+  return NULL;
+}
+
+
+static void resizebuf (lua_State *L, StrBuf *sb, size_t newsize) {
+  size_t oldsize;
+  void *ud;
+  lua_Alloc allocf = lua_getallocf(L, &ud);
+  char *nb = (char *)(*allocf)(ud, sb->b, sb->size, newsize);
+  if (nb == NULL && newsize > 0)
+    luaL_error(L, "not enough memory");
+  sb->b = nb;
+  oldsize = sb->size;
+  sb->size = newsize;
+  lua_accountmem(L, oldsize, newsize);
+}
+
+
+/* makes room for `l' more characters; returns where they go */
+static char *prepbuf (lua_State *L, StrBuf *sb, size_t l) {
+  if (l >= sb->size - sb->n) {  /* no room for them and the '\0'? */
+    size_t newsize = (sb->size < MINSIZE) ? MINSIZE : sb->size;
+    if (l >= MAXSIZE - sb->n)
+      luaL_error(L, "buffer too large");
+    while (l >= newsize - sb->n) {
+      if (newsize > MAXSIZE/2) {  /* cannot double? */
+        newsize = sb->n + l + 1;
+        break;
+      }
+      newsize *= 2;
+    }
+    resizebuf(L, sb, newsize);
+  }
+  return sb->b + sb->n;
+}
+
+
+static void addlstring (lua_State *L, StrBuf *sb, const char *s, size_t l) {
+  memcpy(prepbuf(L, sb, l), s, l);
+  sb->n += l;
+}
+
+
+static int sb_new (lua_State *L) {
+  lua_Number size = luaL_optnumber(L, 1, 0);
+  StrBuf *sb;
+  luaL_argcheck(L, size >= 0, 1, "negative size");
+  sb = (StrBuf *)lua_newuserdata(L, sizeof(StrBuf));
+  sb->b = NULL;
+  sb->n = sb->size = 0;
+  luaL_getmetatable(L, STRBUF);
+  lua_setmetatable(L, -2);
+  if (size > 0) prepbuf(L, sb, (size_t)size);
+  return 1;
+}
+
+
+static int sb_put (lua_State *L) {
+  StrBuf *sb = tobuf(L);
+  int i, top = lua_gettop(L);
+  for (i = 2; i <= top; i++) {
+    StrBuf *o = testbuf(L, i);
+    if (o != NULL) {  /* append another buffer (maybe itself) */
+      size_t l = o->n;
+      char *p = prepbuf(L, sb, l);
+      if (l > 0) memcpy(p, o->b, l);
+      sb->n += l;
+    }
+    else {
+      size_t l;
+      const char *s = luaL_checklstring(L, i, &l);
+      addlstring(L, sb, s, l);
+    }
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/* appends string.format(...) */
+static int sb_putf (lua_State *L) {
+  StrBuf *sb = tobuf(L);
+  size_t l;
+  const char *s;
+  luaL_checkstring(L, 2);
+  lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+  lua_getfield(L, -1, LUA_STRLIBNAME);
+  if (!lua_istable(L, -1))
+    return luaL_error(L, "string library not loaded");
+  lua_getfield(L, -1, "format");
+  lua_replace(L, -3);
+  lua_pop(L, 1);
+  lua_insert(L, 2);  /* sb, format, fmt, ... */
+  lua_call(L, lua_gettop(L) - 2, 1);
+  s = lua_tolstring(L, -1, &l);
+  addlstring(L, sb, s, l);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/* makes room for `n' more characters, so that puts up to it do not grow */
+static int sb_reserve (lua_State *L) {
+  StrBuf *sb = tobuf(L);
+  lua_Number n = luaL_checknumber(L, 2);
+  luaL_argcheck(L, n >= 0, 2, "negative size");
+  prepbuf(L, sb, (size_t)n);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/* empties the buffer (keeping its block) */
+static int sb_reset (lua_State *L) {
+  StrBuf *sb = tobuf(L);
+  sb->n = 0;
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/* returns the contents as a string and empties the buffer */
+static int sb_tostring (lua_State *L) {
+  StrBuf *sb = tobuf(L);
+  if (sb->n <= LUAI_MAXSHORTLEN)  /* would be copied anyway? */
+    lua_pushlstring(L, (sb->n > 0) ? sb->b : "", sb->n);
+  else {  /* give the block to the string */
+    void *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    resizebuf(L, sb, sb->n + 1);  /* trim it (a shrink does not fail) */
+    sb->b[sb->n] = '\0';
+    lua_pushexternalstring(L, sb->b, sb->n, allocf, ud);
+    lua_accountmem(L, sb->size, 0);  /* the string counts it now */
+    sb->b = NULL;
+    sb->size = 0;
+  }
+  sb->n = 0;
+  return 1;
+}
+
+
+static int sb_len (lua_State *L) {
+  lua_pushinteger(L, (lua_Integer)tobuf(L)->n);
+  return 1;
+}
+
+
+static int sb_gc (lua_State *L) {
+  StrBuf *sb = tobuf(L);
+  resizebuf(L, sb, 0);
+  sb->n = 0;
+  return 0;
+}
+
+
+static const luaL_Reg buf_funcs[] = {
+  {"new", sb_new},
+  {NULL, NULL}
+};
+
+
+static const luaL_Reg buf_meta[] = {
+  {"put", sb_put},
+  {"putf", sb_putf},
+  {"reserve", sb_reserve},
+  {"reset", sb_reset},
+  {"tostring", sb_tostring},
+  {"__len", sb_len},
+  {"__gc", sb_gc},
+  {NULL, NULL}
+};
+
+
+LUALIB_API int luaopen_strbuf (lua_State *L) {
+  luaL_newmetatable(L, STRBUF);
+  lua_pushvalue(L, -1);  /* push metatable */
+  lua_setfield(L, -2, "__index");  /* metatable.__index = metatable */
+  luaL_register(L, NULL, buf_meta);
+  lua_pop(L, 1);
+  luaL_register(L, LUA_STRBUFLIBNAME, buf_funcs);
+  return 1;
+}
+
@@ -859,3 +859,47 @@ void luaK_setlist (FuncState *fs, int base, int nelems, int tostore) {
   fs->freereg = base + 1;  /* free registers with list values */
 }
 
+
+/*
+** superinstruction for the pair `o1' `o2' (see the notes in lopcodes.h),
+** or `o1' itself if the pair is not fused
+*/
+static OpCode fusedop (OpCode o1, OpCode o2) {
+  switch (o1) {
+    case OP_MOVE:
+      return (o2 == OP_MOVE) ? OP_MOVE_MOVE :
+             (o2 == OP_CALL) ? OP_MOVE_CALL : o1;
+    case OP_GETGLOBAL:
+      return (o2 == OP_GETTABLE) ? OP_GETGLOBAL_GETTABLE : o1;
+    case OP_GETTABLE:
+      return (o2 == OP_GETTABLE) ? OP_GETTABLE_GETTABLE : o1;
+    default: return o1;
+  }
+}
+
+
+/*
+** rewrite the first instruction of each fusable pair of a finished
+** function; the second one of a pair is never fused again, and the
+** words that are not instructions (extra SETLIST argument, upvalue
+** pseudo-instructions of OP_CLOSURE) are left alone
+*/
+void luaK_fuse (Proto *f) {
+  Instruction *code = f->code;
+  int pc;
+  for (pc = 0; pc + 1 < f->sizecode; pc++) {
+    Instruction i = code[pc];
+    OpCode o = GET_OPCODE(i);
+    if (o == OP_SETLIST && GETARG_C(i) == 0)
+      pc++;
+    else if (o == OP_CLOSURE)
+      pc += f->p[GETARG_Bx(i)]->nups;
+    else {
+      OpCode fo = fusedop(o, GET_OPCODE(code[pc + 1]));
+      if (fo != o) {
+        SET_OPCODE(code[pc], fo);
+        pc++;
+      }
+    }
+  }
+}
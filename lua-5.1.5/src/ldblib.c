@@ -392,7 +392,6 @@ static const luaL_Reg dblib[] = {
 
 
 LUALIB_API int luaopen_debug (lua_State *L) {
-  printf("debug: 8.luaopen_debug\n");
   luaL_register(L, LUA_DBLIBNAME, dblib);
   return 1;
 }
@@ -51,7 +51,9 @@ static int currentline (lua_State *L, CallInfo *ci) {
 
 
 /*
-** this function can be called asynchronous (e.g. during a signal)
+** this function can be called asynchronous (e.g. during a signal);
+** a running `luaV_execute' sees the new line/count mask at its next
+** safe point (see `updatetrap' in lvm.c)
 */
 LUA_API int lua_sethook (lua_State *L, lua_Hook func, int mask, int count) {
   if (func == NULL || mask == 0) {  /* turn off hooks? */
@@ -329,6 +331,9 @@ static Instruction symbexec (const Proto *pt, int lastpc, int reg) {
     int b = 0;
     int c = 0;
     check(op < NUM_OPCODES);
+    /* code to be loaded must be generic; running code may be rewritten */
+    check(reg != NO_REG || genericop(op) == op);
+    op = genericop(op);
     checkreg(pt, a);
     switch (getOpMode(op)) {
       case iABC: {
@@ -512,7 +517,7 @@ static const char *getobjname (lua_State *L, CallInfo *ci, int stackpos,
       return "local";
     i = symbexec(p, pc, stackpos);  /* try symbolic execution */
     lua_assert(pc != -1);
-    switch (GET_OPCODE(i)) {
+    switch (genericop(GET_OPCODE(i))) {
       case OP_GETGLOBAL: {
         int g = GETARG_Bx(i);  /* global index */
         lua_assert(ttisstring(&p->k[g]));
@@ -26,6 +26,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "ltrace.h"
 #include "lundump.h"
 #include "lvm.h"
 #include "lzio.h"
@@ -280,7 +281,6 @@ static StkId tryfuncTM (lua_State *L, StkId func) {
 ** #define clvalue(o) check_exp(ttisfunction(o), &(o)->value.gc->cl)
 */
 int luaD_precall (lua_State *L, StkId func, int nresults) {
-  printf("debug: in luaD_precall\n");
   LClosure *cl;
   ptrdiff_t funcr;
   if (!ttisfunction(func)) /* `func' is not a function? */
@@ -289,10 +289,10 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
   cl = &clvalue(func)->l; /* 取出栈指针func指向的函数原型 Closure */
   L->ci->savedpc = L->savedpc; /* 保存上个函数执行指令跳转时的下一个指令 */
   if (!cl->isC) {  /* Lua function? prepare its call */
-    printf("debug: 执行 Lua function\n");
     CallInfo *ci;
     StkId st, base;
     Proto *p = cl->p;
+    luaR_trace(L, LUA_TRACECALL, "precall Lua", nresults, p->numparams);
     luaD_checkstack(L, p->maxstacksize);
     func = restorestack(L, funcr);
     if (!p->is_vararg) {  /* no varargs? */
@@ -324,9 +324,9 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
     return PCRLUA;
   }
   else {  /* if is a C function, call it */
-    printf("debug: 执行 C function\n");
     CallInfo *ci;
     int n;
+    luaR_trace(L, LUA_TRACECALL, "precall C", nresults, 0);
     luaD_checkstack(L, LUA_MINSTACK);  /* ensure minimum stack size */
     ci = inc_ci(L);  /* now `enter' new function */
     ci->func = restorestack(L, funcr);
@@ -362,10 +362,10 @@ static StkId callrethooks (lua_State *L, StkId firstResult) {
 
 
 int luaD_poscall (lua_State *L, StkId firstResult) {
-  printf("debug: in luaD_poscall\n");
   StkId res;
   int wanted, i;
   CallInfo *ci;
+  luaR_trace(L, LUA_TRACECALL, "poscall", L->ci->nresults, 0);
   if (L->hookmask & LUA_MASKRET)
     firstResult = callrethooks(L, firstResult);
   ci = L->ci--;
@@ -485,12 +485,12 @@ LUA_API int lua_yield (lua_State *L, int nresults) {
 /*  protected call */
 int luaD_pcall (lua_State *L, Pfunc func, void *u,
                 ptrdiff_t old_top, ptrdiff_t ef) {
-  printf("debug: in luaD_pcall\n");
   int status;
   unsigned short oldnCcalls = L->nCcalls;
   ptrdiff_t old_ci = saveci(L, L->ci); /* sizeof(CallInfo) = 40 */
   lu_byte old_allowhooks = L->allowhook;
   ptrdiff_t old_errfunc = L->errfunc;
+  luaR_trace(L, LUA_TRACEPCALL, "pcall", L->nCcalls, 0);
   L->errfunc = ef;
   /* 只会执行3个函数之一, f_Ccall 或者 f_call 或者 f_parser */
   status = luaD_rawrunprotected(L, func, u);
@@ -506,6 +506,7 @@ int luaD_pcall (lua_State *L, Pfunc func, void *u,
     restore_stack_limit(L);
   }
   L->errfunc = old_errfunc;
+  luaR_trace(L, LUA_TRACEPCALL, "pcall end", L->nCcalls, status);
   return status;
 }
 
@@ -532,7 +533,7 @@ static void f_parser (lua_State *L, void *ud) {
   luaC_checkGC(L);
   tf = ((c == LUA_SIGNATURE[0]) ? luaU_undump : luaY_parser)(L, p->z,
                                                              &p->buff, p->name);
-  printf("*********** tf->nups = %d\n", tf->nups);
+  luaR_trace(L, LUA_TRACEPCALL, "parser", tf->nups, 0);
   cl = luaF_newLclosure(L, tf->nups, hvalue(gt(L)));
   cl->l.p = tf;
   for (i = 0; i < tf->nups; i++)  /* initialize eventual upvalues */
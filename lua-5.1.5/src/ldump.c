@@ -12,6 +12,7 @@
 #include "lua.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
 
@@ -73,7 +74,20 @@ static void DumpString(const TString* s, DumpState* D)
  }
 }
 
-#define DumpCode(f,D)	 DumpVector(f->code,f->sizecode,sizeof(Instruction),D)
+static void DumpCode(const Proto* f, DumpState* D)
+{
+ int i,n=f->sizecode;
+ DumpInt(n,D);
+ for (i=0; i<n; i++)
+ {
+  Instruction c=f->code[i];
+  OpCode o=GET_OPCODE(c);
+  SET_OPCODE(c,genericop(o));	/* dump generic form */
+  DumpVar(c,D);
+  if (o==OP_SETLIST && GETARG_C(c)==0 && i+1<n)
+   DumpVar(f->code[++i],D);	/* next word is a raw C, not an instruction */
+ }
+}
 
 static void DumpFunction(const Proto* f, const TString* p, DumpState* D);
 
@@ -160,6 +160,7 @@ Proto *luaF_newproto (lua_State *L) {
   f->code = NULL;
   f->sizecode = 0;
   f->sizelineinfo = 0;
+  f->sizecache = 0;
   f->sizeupvalues = 0;
   f->nups = 0;
   f->upvalues = NULL;
@@ -167,6 +168,7 @@ Proto *luaF_newproto (lua_State *L) {
   f->is_vararg = 0;
   f->maxstacksize = 0;
   f->lineinfo = NULL;
+  f->cache = NULL;
   f->sizelocvars = 0;
   f->locvars = NULL;
   f->linedefined = 0;
@@ -176,11 +178,24 @@ Proto *luaF_newproto (lua_State *L) {
 }
 
 
+/*
+** create the inline caches of a finished prototype (one slot per
+** instruction; see `getcached' in lvm.c)
+*/
+void luaF_newcache (lua_State *L, Proto *f) {
+  int i;
+  f->cache = luaM_newvector(L, f->sizecode, int);
+  f->sizecache = f->sizecode;
+  for (i=0; i<f->sizecache; i++) f->cache[i] = 0;
+}
+
+
 void luaF_freeproto (lua_State *L, Proto *f) {
   luaM_freearray(L, f->code, f->sizecode, Instruction);
   luaM_freearray(L, f->p, f->sizep, Proto *);
   luaM_freearray(L, f->k, f->sizek, TValue);
   luaM_freearray(L, f->lineinfo, f->sizelineinfo, int);
+  luaM_freearray(L, f->cache, f->sizecache, int);
   luaM_freearray(L, f->locvars, f->sizelocvars, struct LocVar);
   luaM_freearray(L, f->upvalues, f->sizeupvalues, TString *);
   luaM_free(L, f);
@@ -21,6 +21,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "ltrace.h"
 
 
 #define GCSTEPSIZE	1024u
@@ -58,6 +59,12 @@
 
 #define setthreshold(g)  (g->GCthreshold = (g->estimate/100) * g->gcpause)
 
+#if defined(LUA_SHAPES)
+#define sizeslots(h)	(sizeof(TValue) * (h)->sizeslots)
+#else
+#define sizeslots(h)	0
+#endif
+
 
 static void removeentry (Node *n) {
   lua_assert(ttisnil(gval(n)));
@@ -155,6 +162,35 @@ size_t luaC_separateudata (lua_State *L, int all) {
 }
 
 
+static void traversenodes (global_State *g, Table *h, int weakkey,
+                                                      int weakvalue) {
+  int i = sizenode(h);
+  while (i--) {
+    Node *n = gnode(h, i);
+    lua_assert(ttype(gkey(n)) != LUA_TDEADKEY || ttisnil(gval(n)));
+    if (ttisnil(gval(n)))
+      removeentry(n);  /* remove empty entries */
+    else {
+      lua_assert(!ttisnil(gkey(n)));
+      if (!weakkey) markvalue(g, gkey(n));
+      if (!weakvalue) markvalue(g, gval(n));
+    }
+  }
+}
+
+
+#if defined(LUA_SHAPES)
+/* marks a shape in use, with its ancestors and their keys */
+static void markshape (global_State *g, Shape *s) {
+  for (; s != NULL && s->marked != g->shapemark; s = s->parent) {
+    s->marked = g->shapemark;
+    if (s->nkeys > 0)
+      stringmark(s->keys[s->nkeys - 1]);
+  }
+}
+#endif
+
+
 static int traversetable (global_State *g, Table *h) {
   int i;
   int weakkey = 0;
@@ -174,24 +210,25 @@ static int traversetable (global_State *g, Table *h) {
       g->weak = obj2gco(h);  /* ... so put in the appropriate list */
     }
   }
+#if defined(LUA_SHAPES)
+  if (h->shape != NULL) {
+    markshape(g, h->shape);  /* its keys are strings, never weak */
+    if (!weakvalue) {
+      i = h->shape->nkeys;
+      while (i--)
+        markvalue(g, &h->slots[i]);
+    }
+  }
+#endif
   if (weakkey && weakvalue) return 1;
   if (!weakvalue) {
     i = h->sizearray;
     while (i--)
       markvalue(g, &h->array[i]);
   }
-  i = sizenode(h);
-  while (i--) {
-    Node *n = gnode(h, i);
-    lua_assert(ttype(gkey(n)) != LUA_TDEADKEY || ttisnil(gval(n)));
-    if (ttisnil(gval(n)))
-      removeentry(n);  /* remove empty entries */
-    else {
-      lua_assert(!ttisnil(gkey(n)));
-      if (!weakkey) markvalue(g, gkey(n));
-      if (!weakvalue) markvalue(g, gval(n));
-    }
-  }
+  traversenodes(g, h, weakkey, weakvalue);
+  if (h->oldhash)  /* being resized? */
+    traversenodes(g, h->oldhash, weakkey, weakvalue);
   return weakkey || weakvalue;
 }
 
@@ -285,7 +322,10 @@ static l_mem propagatemark (global_State *g) {
       if (traversetable(g, h))  /* table is weak? */
         black2gray(o);  /* keep it gray */
       return sizeof(Table) + sizeof(TValue) * h->sizearray +
-                             sizeof(Node) * sizenode(h);
+                             sizeof(Node) * sizenode(h) +
+                             (h->oldhash ? sizeof(Node) * sizenode(h->oldhash) : 0) +
+                             (h->disp ? sizeof(int) * sizedisp(h) : 0) +
+                             sizeslots(h);
     }
     case LUA_TFUNCTION: {
       Closure *cl = gco2cl(o);
@@ -312,6 +352,7 @@ static l_mem propagatemark (global_State *g) {
                              sizeof(Proto *) * p->sizep +
                              sizeof(TValue) * p->sizek + 
                              sizeof(int) * p->sizelineinfo +
+                             sizeof(int) * p->sizecache +
                              sizeof(LocVar) * p->sizelocvars +
                              sizeof(TString *) * p->sizeupvalues;
     }
@@ -345,6 +386,19 @@ static int iscleared (const TValue *o, int iskey) {
 }
 
 
+static void clearnodes (Table *h) {
+  int i = sizenode(h);
+  while (i--) {
+    Node *n = gnode(h, i);
+    if (!ttisnil(gval(n)) &&  /* non-empty entry? */
+        (iscleared(key2tval(n), 1) || iscleared(gval(n), 0))) {
+      setnilvalue(gval(n));  /* remove value ... */
+      removeentry(n);  /* remove entry from table */
+    }
+  }
+}
+
+
 /*
 ** clear collected entries from weaktables
 */
@@ -360,16 +414,20 @@ static void cleartable (GCObject *l) {
         if (iscleared(o, 0))  /* value was collected? */
           setnilvalue(o);  /* remove value */
       }
-    }
-    i = sizenode(h);
-    while (i--) {
-      Node *n = gnode(h, i);
-      if (!ttisnil(gval(n)) &&  /* non-empty entry? */
-          (iscleared(key2tval(n), 1) || iscleared(gval(n), 0))) {
-        setnilvalue(gval(n));  /* remove value ... */
-        removeentry(n);  /* remove entry from table */
+#if defined(LUA_SHAPES)
+      if (h->shape != NULL) {
+        i = h->shape->nkeys;
+        while (i--) {
+          TValue *o = &h->slots[i];
+          if (iscleared(o, 0))
+            setnilvalue(o);
+        }
       }
+#endif
     }
+    clearnodes(h);
+    if (h->oldhash)  /* being resized? */
+      clearnodes(h->oldhash);
     l = h->gclist;
   }
 }
@@ -386,11 +444,7 @@ static void freeobj (lua_State *L, GCObject *o) {
       luaE_freethread(L, gco2th(o));
       break;
     }
-    case LUA_TSTRING: {
-      G(L)->strt.nuse--;
-      luaM_freemem(L, o, sizestring(gco2ts(o)));
-      break;
-    }
+    case LUA_TSTRING: luaS_freestr(L, rawgco2ts(o)); break;
     case LUA_TUSERDATA: {
       luaM_freemem(L, o, sizeudata(gco2u(o)));
       break;
@@ -428,6 +482,26 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
 }
 
 
+/*
+** sweeps whole buckets of the string table until about `count' buckets
+** and strings have been visited; returns how many were
+*/
+static lu_mem sweepstrings (lua_State *L, lu_mem count) {
+  global_State *g = G(L);
+  stringtable *tb = &g->strt;
+  lu_mem n = 0;
+  while (n < count && g->sweepstrgc < tb->size + tb->oldsize) {
+    int i = g->sweepstrgc++;
+    GCObject **p = (i < tb->size) ? &tb->hash[i] : &tb->oldhash[i - tb->size];
+    GCObject *o;
+    for (o = *p; o != NULL; o = o->gch.next) n++;
+    sweepwholelist(L, p);
+    n++;
+  }
+  return n;
+}
+
+
 static void checkSizes (lua_State *L) {
   global_State *g = G(L);
   /* check size of string hash */
@@ -487,6 +561,8 @@ void luaC_freeall (lua_State *L) {
   sweepwholelist(L, &g->rootgc);
   for (i = 0; i < g->strt.size; i++)  /* free all string lists */
     sweepwholelist(L, &g->strt.hash[i]);
+  for (i = 0; i < g->strt.oldsize; i++)  /* including those not moved */
+    sweepwholelist(L, &g->strt.oldhash[i]);
 }
 
 
@@ -494,6 +570,7 @@ static void markmt (global_State *g) {
   int i;
   for (i=0; i<NUM_TAGS; i++)
     if (g->mt[i]) markobject(g, g->mt[i]);
+  if (g->tamt) markobject(g, g->tamt);
 }
 
 
@@ -508,6 +585,9 @@ static void markroot (lua_State *L) {
   markvalue(g, gt(g->mainthread));
   markvalue(g, registry(L));
   markmt(g);
+#if defined(LUA_SHAPES)
+  g->shapemark++;  /* no shape is marked in use yet */
+#endif
   g->gcstate = GCSpropagate;
 }
 
@@ -544,6 +624,9 @@ static void atomic (lua_State *L) {
   marktmu(g);  /* mark `preserved' userdata */
   udsize += propagateall(g);  /* remark, to propagate `preserveness' */
   cleartable(g->weak);  /* remove collected objects from weak tables */
+#if defined(LUA_SHAPES)
+  luaH_sweepshapes(L);  /* free shapes no longer used */
+#endif
   /* flip current white */
   g->currentwhite = cast_byte(otherwhite(g));
   g->sweepstrgc = 0;
@@ -571,29 +654,35 @@ static l_mem singlestep (lua_State *L) {
     }
     case GCSsweepstring: {
       lu_mem old = g->totalbytes;
-      sweepwholelist(L, &g->strt.hash[g->sweepstrgc++]);
-      if (g->sweepstrgc >= g->strt.size)  /* nothing more to sweep? */
+      lu_mem n = sweepstrings(L, GCSWEEPMAX);
+      if (g->sweepstrgc >= g->strt.size + g->strt.oldsize)  /* all swept? */
         g->gcstate = GCSsweep;  /* end sweep-string phase */
       lua_assert(old >= g->totalbytes);
       g->estimate -= old - g->totalbytes;
-      return GCSWEEPCOST;
+      return n*GCSWEEPCOST;
     }
     case GCSsweep: {
       lu_mem old = g->totalbytes;
       g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
+      lua_assert(old >= g->totalbytes);
+      g->estimate -= old - g->totalbytes;
       if (*g->sweepgc == NULL) {  /* nothing more to sweep? */
-        checkSizes(L);
+        old = g->totalbytes;
+        checkSizes(L);  /* (a shrinking `strt' keeps both vectors for a while) */
+        g->estimate += g->totalbytes - old;
         g->gcstate = GCSfinalize;  /* end sweep phase */
       }
-      lua_assert(old >= g->totalbytes);
-      g->estimate -= old - g->totalbytes;
       return GCSWEEPMAX*GCSWEEPCOST;
     }
     case GCSfinalize: {
       if (g->tmudata) {
+        lu_mem old = g->totalbytes;
+        lu_mem freed;
         GCTM(L);
-        if (g->estimate > GCFINALIZECOST)
-          g->estimate -= GCFINALIZECOST;
+        /* a finalizer may release memory counted in the estimate */
+        freed = (old > g->totalbytes) ? old - g->totalbytes : 0;
+        if (g->estimate > freed + GCFINALIZECOST)
+          g->estimate -= freed + GCFINALIZECOST;
         return GCFINALIZECOST;
       }
       else {
@@ -612,6 +701,7 @@ void luaC_step (lua_State *L) {
   l_mem lim = (GCSTEPSIZE/100) * g->gcstepmul;
   if (lim == 0)
     lim = (MAX_LUMEM-1)/2;  /* no limit */
+  luaR_trace(L, LUA_TRACEGC, "step", g->gcstate, cast_int(g->totalbytes >> 10));
   g->gcdept += g->totalbytes - g->GCthreshold;
   do {
     lim -= singlestep(L);
@@ -634,6 +724,7 @@ void luaC_step (lua_State *L) {
 
 void luaC_fullgc (lua_State *L) {
   global_State *g = G(L);
+  luaR_trace(L, LUA_TRACEGC, "fullgc", g->gcstate, cast_int(g->totalbytes >> 10));
   if (g->gcstate <= GCSpropagate) {
     /* reset sweep marks to sweep all elements (returning them to white) */
     g->sweepstrgc = 0;
@@ -662,7 +753,7 @@ void luaC_barrierf (lua_State *L, GCObject *o, GCObject *v) {
   global_State *g = G(L);
   lua_assert(isblack(o) && iswhite(v) && !isdead(g, v) && !isdead(g, o));
   lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
-  lua_assert(ttype(&o->gch) != LUA_TTABLE);
+  lua_assert(o->gch.tt != LUA_TTABLE);
   /* must keep invariant? */
   if (g->gcstate == GCSpropagate)
     reallymarkobject(g, v);  /* restore invariant */
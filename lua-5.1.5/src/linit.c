@@ -27,13 +27,15 @@ static const luaL_Reg lualibs[] = {
   {LUA_OSLIBNAME, luaopen_os},
   {LUA_STRLIBNAME, luaopen_string},
   {LUA_MATHLIBNAME, luaopen_math},
+  {LUA_BITLIBNAME, luaopen_bit},
+  {LUA_ARRAYLIBNAME, luaopen_array},
+  {LUA_STRBUFLIBNAME, luaopen_strbuf},
   {LUA_DBLIBNAME, luaopen_debug},
   {NULL, NULL}
 };
 
 
 LUALIB_API void luaL_openlibs (lua_State *L) {
-  printf("debug: in luaL_openlibs\n");
   const luaL_Reg *lib = lualibs;
   for (; lib->func; lib++) {
     lua_pushcfunction(L, lib->func);
@@ -545,7 +545,6 @@ static void newfenv (lua_State *L, lua_CFunction cls) {
 }
 */
 LUALIB_API int luaopen_io (lua_State *L) {
-  printf("debug: 4.luaopen_io\n");
   createmeta(L);
   /* create (private) environment (with fields IO_INPUT, IO_OUTPUT, __close) */
   newfenv(L, io_fclose);
@@ -249,7 +249,6 @@ static const luaL_Reg mathlib[] = {
 ** Open math library
 */
 LUALIB_API int luaopen_math (lua_State *L) {
-  printf("debug: 7.luaopen_math\n");
   luaL_register(L, LUA_MATHLIBNAME, mathlib);
   lua_pushnumber(L, PI);
   lua_setfield(L, -2, "pi");
@@ -635,7 +635,6 @@ static const lua_CFunction loaders[] =
 }
 */
 LUALIB_API int luaopen_package (lua_State *L) {
-  printf("debug: 2.luaopen_package\n");
   int i;
   /* create new type _LOADLIB */
   luaL_newmetatable(L, "_LOADLIB");
@@ -53,6 +53,8 @@ typedef struct GCheader {
 
 
 
+#if !defined(LUA_NANBOX)
+
 /*
 ** Union of all Lua values
 */
@@ -70,14 +72,46 @@ typedef union {
 
 #define TValuefields	Value value; int tt
 
+#define NILCONSTANT	{NULL}, LUA_TNIL
+
+#else
+
+/*
+** NaN boxing: a value is a single 64-bit word. A number is stored as
+** itself; any other value is a negative quiet NaN with `tag + 1' in
+** bits 47-50 and a pointer or a boolean in bits 0-46. Every number
+** (including the NaNs made by arithmetic) is below nbtag(LUA_TNIL).
+*/
+typedef union {
+  LUAI_UINT64 u;  /* first, so that NILCONSTANT can initialize it */
+  lua_Number n;
+} Value;
+
+#define NB_PAYLOAD	((cast(LUAI_UINT64, 1) << 47) - 1)
+#define nbtag(t)	((cast(LUAI_UINT64, 0xFFF8) << 48) | \
+                         (cast(LUAI_UINT64, (t) + 1) << 47))
+#define nbox(t,p)	(nbtag(t) | check_exp(nbfits(p), \
+                                   cast(LUAI_UINT64, cast(size_t, (p)))))
+#define nbfits(p)	((cast(LUAI_UINT64, cast(size_t, (p))) & ~NB_PAYLOAD) == 0)
+#define nbptr(o)	cast(void *, cast(size_t, (o)->value.u & NB_PAYLOAD))
+#define nbis(o,t)	(((o)->value.u >> 47) == (nbtag(t) >> 47))
+
+#define TValuefields	Value value
+
+#define NILCONSTANT	{nbtag(LUA_TNIL)}
+
+#endif
+
 typedef struct lua_TValue {
   TValuefields;
 } TValue;
-/* sizeof(TValue) = 16 */
+/* sizeof(TValue) = 16 (8 with LUA_NANBOX) */
 
 /*
 ** #define check_exp(c,e)   (lua_assert(c), (e)) //逗号表达式，返回(e)
 */
+#if !defined(LUA_NANBOX)
+
 /* Macros to test type */
 #define ttisnil(o)	(ttype(o) == LUA_TNIL)
 #define ttisnumber(o)	(ttype(o) == LUA_TNUMBER)
@@ -95,30 +129,61 @@ typedef struct lua_TValue {
 #define pvalue(o)	check_exp(ttislightuserdata(o), (o)->value.p)
 #define nvalue(o)	check_exp(ttisnumber(o), (o)->value.n)
 #define rawtsvalue(o)	check_exp(ttisstring(o), &(o)->value.gc->ts)
-#define tsvalue(o)	(&rawtsvalue(o)->tsv)
 #define rawuvalue(o)	check_exp(ttisuserdata(o), &(o)->value.gc->u)
-#define uvalue(o)	(&rawuvalue(o)->uv)
 #define clvalue(o)	check_exp(ttisfunction(o), &(o)->value.gc->cl)
 #define hvalue(o)	check_exp(ttistable(o), &(o)->value.gc->h)
 #define bvalue(o)	check_exp(ttisboolean(o), (o)->value.b)
 #define thvalue(o)	check_exp(ttisthread(o), &(o)->value.gc->th)
 
+#else
+
+/* Macros to test type */
+#define ttisnil(o)	((o)->value.u == nbtag(LUA_TNIL))
+#define ttisnumber(o)	((o)->value.u < nbtag(LUA_TNIL))
+#define ttisstring(o)	nbis(o, LUA_TSTRING)
+#define ttistable(o)	nbis(o, LUA_TTABLE)
+#define ttisfunction(o)	nbis(o, LUA_TFUNCTION)
+#define ttisboolean(o)	nbis(o, LUA_TBOOLEAN)
+#define ttisuserdata(o)	nbis(o, LUA_TUSERDATA)
+#define ttisthread(o)	nbis(o, LUA_TTHREAD)
+#define ttislightuserdata(o)	nbis(o, LUA_TLIGHTUSERDATA)
+
+/* Macros to access values */
+#define ttype(o)	(ttisnumber(o) ? LUA_TNUMBER : \
+                         cast_int(((o)->value.u >> 47) & 0xF) - 1)
+#define gcvalue(o)	check_exp(iscollectable(o), cast(GCObject *, nbptr(o)))
+#define pvalue(o)	check_exp(ttislightuserdata(o), nbptr(o))
+#define nvalue(o)	check_exp(ttisnumber(o), (o)->value.n)
+#define rawtsvalue(o)	check_exp(ttisstring(o), cast(TString *, nbptr(o)))
+#define rawuvalue(o)	check_exp(ttisuserdata(o), cast(Udata *, nbptr(o)))
+#define clvalue(o)	check_exp(ttisfunction(o), cast(Closure *, nbptr(o)))
+#define hvalue(o)	check_exp(ttistable(o), cast(struct Table *, nbptr(o)))
+#define bvalue(o)	check_exp(ttisboolean(o), cast_int((o)->value.u & 1))
+#define thvalue(o)	check_exp(ttisthread(o), cast(lua_State *, nbptr(o)))
+
+#endif
+
+#define tsvalue(o)	(&rawtsvalue(o)->tsv)
+#define uvalue(o)	(&rawuvalue(o)->uv)
+
 #define l_isfalse(o)	(ttisnil(o) || (ttisboolean(o) && bvalue(o) == 0))
 
 /*
 ** for internal debug only
 */
 #define checkconsistency(obj) \
-  lua_assert(!iscollectable(obj) || (ttype(obj) == (obj)->value.gc->gch.tt))
+  lua_assert(!iscollectable(obj) || (ttype(obj) == gcvalue(obj)->gch.tt))
 
 #define checkliveness(g,obj) \
   lua_assert(!iscollectable(obj) || \
-  ((ttype(obj) == (obj)->value.gc->gch.tt) && !isdead(g, (obj)->value.gc)))
+  ((ttype(obj) == gcvalue(obj)->gch.tt) && !isdead(g, gcvalue(obj))))
 /*
 **  #define iscollectable(o)  (ttype(o) >= LUA_TSTRING)
 */
 
 
+#if !defined(LUA_NANBOX)
+
 /* Macros to set values */
 #define setnilvalue(obj) ((obj)->tt=LUA_TNIL)
 
@@ -169,6 +234,63 @@ typedef struct lua_TValue {
     o1->value = o2->value; o1->tt=o2->tt; \
     checkliveness(G(L),o1); }
 
+#define setttype(obj, tt) (ttype(obj) = (tt))
+
+#define iscollectable(o)	(ttype(o) >= LUA_TSTRING)
+
+/* numbers coming from outside the core need no care */
+#define canonnan(obj)	((void)0)
+
+#else
+
+/* Macros to set values */
+#define setnilvalue(obj) ((obj)->value.u=nbtag(LUA_TNIL))
+
+#define setnvalue(obj,x) \
+  { TValue *i_o=(obj); i_o->value.n=(x); }
+
+#define setpvalue(obj,x) \
+  { TValue *i_o=(obj); void *i_x=(x); \
+    i_o->value.u=nbox(LUA_TLIGHTUSERDATA, i_x); }
+
+#define setbvalue(obj,x) \
+  { TValue *i_o=(obj); i_o->value.u=nbtag(LUA_TBOOLEAN) | ((x) != 0); }
+
+#define setgcvalue(L,obj,x,t) \
+  { TValue *i_o=(obj); GCObject *i_x=cast(GCObject *, (x)); \
+    i_o->value.u=nbox(t, i_x); checkliveness(G(L),i_o); }
+
+#define setsvalue(L,obj,x)	setgcvalue(L,obj,x,LUA_TSTRING)
+#define setuvalue(L,obj,x)	setgcvalue(L,obj,x,LUA_TUSERDATA)
+#define setthvalue(L,obj,x)	setgcvalue(L,obj,x,LUA_TTHREAD)
+#define setclvalue(L,obj,x)	setgcvalue(L,obj,x,LUA_TFUNCTION)
+#define sethvalue(L,obj,x)	setgcvalue(L,obj,x,LUA_TTABLE)
+#define setptvalue(L,obj,x)	setgcvalue(L,obj,x,LUA_TPROTO)
+
+#define setobj(L,obj1,obj2) \
+  { const TValue *o2=(obj2); TValue *o1=(obj1); \
+    o1->value = o2->value; \
+    checkliveness(G(L),o1); }
+
+#define setttype(obj, tt) \
+  ((obj)->value.u = ((obj)->value.u & NB_PAYLOAD) | nbtag(tt))
+
+#define iscollectable(o)	((o)->value.u >= nbtag(LUA_TSTRING))
+
+/*
+** a NaN made outside the core (strtod, C code, a binary chunk) may have
+** any sign and payload, which arithmetic keeps (a negation only flips its
+** sign); so every NaN is replaced by the same quiet NaN, which is read
+** back as a number with either sign
+*/
+#define NB_CANONNAN	(cast(LUAI_UINT64, 0x7FF8) << 48)
+
+#define canonnan(obj) \
+  { TValue *i_o=(obj); \
+    if (luai_numisnan(i_o->value.n)) i_o->value.u = NB_CANONNAN; }
+
+#endif
+
 
 /*
 ** different types of sets, according to destination
@@ -189,11 +311,6 @@ typedef struct lua_TValue {
 #define setobj2n	setobj
 #define setsvalue2n	setsvalue
 
-#define setttype(obj, tt) (ttype(obj) = (tt))
-
-
-#define iscollectable(o)	(ttype(o) >= LUA_TSTRING)
-
 
 
 typedef TValue *StkId;  /* index to stack elements */
@@ -207,13 +324,33 @@ typedef union TString {
   struct {
     CommonHeader;
     lu_byte reserved;
+    lu_byte kind;  /* STR* bits below; 0 for short strings */
     unsigned int hash;
     size_t len;
   } tsv;
 } TString;
 
+/* bits of `tsv.kind' */
+#define STRLONG		1  /* not interned (see lstring.c) */
+#define STRHASHED	2  /* long string whose `hash' is already computed */
+#define STREXT		4  /* contents owned by the embedder (see ExtString) */
+#define STROWNED	8  /* external contents adopted by the state */
+
 
-#define getstr(ts)	cast(const char *, (ts) + 1)
+/*
+** An external string keeps this after its header instead of its
+** characters (see `luaS_newext')
+*/
+typedef struct ExtString {
+  const char *s;
+  lua_Alloc freef;  /* releases `s' (may be NULL, or unused if STROWNED) */
+  void *ud;
+} ExtString;
+
+#define extstr(ts)	cast(ExtString *, (ts) + 1)
+
+#define getstr(ts) \
+	(((ts)->tsv.kind & STREXT) ? extstr(ts)->s : cast(const char *, (ts) + 1))
 /*
 ** ts 为 TString*，ts+1意味着ts指针递增一个sizeof(TString)的距离，
 ** 可以看出，字符串实际存储的位置如图：
@@ -232,6 +369,7 @@ typedef union Udata {
   L_Umaxalign dummy;  /* ensures maximum alignment for `local' udata */
   struct {
     CommonHeader;
+    lu_byte istarray;  /* holds a typed array? (see larray.h) */
     struct Table *metatable;
     struct Table *env;
     size_t len;
@@ -251,6 +389,7 @@ typedef struct Proto {
   Instruction *code;
   struct Proto **p;  /* functions defined inside the function */
   int *lineinfo;  /* map from opcodes to source lines */
+  int *cache;  /* inline caches for table lookups, one per opcode */
   struct LocVar *locvars;  /* information about local variables */
   TString **upvalues;  /* upvalue names */
   TString  *source;
@@ -258,6 +397,7 @@ typedef struct Proto {
   int sizek;  /* size of `k' */
   int sizecode;
   int sizelineinfo;
+  int sizecache;
   int sizep;  /* size of `p' */
   int sizelocvars;
   int linedefined;
@@ -342,7 +482,9 @@ typedef union Closure {
 typedef union TKey {
   struct {
     TValuefields;
+#if !defined(LUA_SWISSTABLE)
     struct Node *next;  /* for chaining */
+#endif
   } nk;
   TValue tvk;
 } TKey;
@@ -354,6 +496,22 @@ typedef struct Node {
 } Node;
 
 
+#if defined(LUA_SHAPES)
+/*
+** The string keys of a hash part, in insertion order, shared by all
+** tables that got the same keys in the same order (see ltable.c)
+*/
+typedef struct Shape {
+  struct Shape *parent;  /* shape without the last key */
+  struct Shape *kids;  /* shapes with one more key */
+  struct Shape *sibling;  /* next kid of `parent' */
+  int nkeys;
+  lu_byte marked;  /* equal to `shapemark' when in use (see lgc.c) */
+  TString *keys[1];
+} Shape;
+#endif
+
+
 /*
 ** lua表的结构，分数组部分和散列表部分，两个部分其实都是一段连续的空间，也就是数组。
 ** lua数组部分的关键字key很显然只能是整型数字。
@@ -362,12 +520,26 @@ typedef struct Table {
   CommonHeader;
   lu_byte flags;  /* 1<<p means tagmethod(p) is not present */ 
   lu_byte lsizenode;  /* log2 of size of `node' array */
+  lu_byte frozen;  /* true if contents cannot change (see `luaH_freeze') */
   struct Table *metatable;
   TValue *array;  /* array part */
   Node *node;
+#if defined(LUA_SWISSTABLE)
+  lu_byte *ctrl;  /* control bytes of `node' (see ltable.c) */
+  int nfree;  /* number of keys that still fit before a rehash */
+#else
   Node *lastfree;  /* any free position is before this position */
+#endif
+  struct Table *oldhash;  /* hash part being moved (see ltable.c) */
+  int *disp;  /* perfect hash of a frozen table (see ltable.c), or NULL */
+#if defined(LUA_SHAPES)
+  struct Shape *shape;  /* keys of the hash part, or NULL (see ltable.c) */
+  TValue *slots;  /* values of the keys in `shape' */
+  int sizeslots;
+#endif
   GCObject *gclist;
   int sizearray;  /* size of `array' array */
+  int border;  /* last length computed (a hint for `luaH_getn') */
 } Table;
 
 
@@ -52,6 +52,18 @@ const char *const luaP_opnames[NUM_OPCODES+1] = {
   "CLOSE",
   "CLOSURE",
   "VARARG",
+  "QADD",
+  "QSUB",
+  "QMUL",
+  "QDIV",
+  "QMOD",
+  "QPOW",
+  "QLT",
+  "QLE",
+  "MOVE_MOVE",
+  "MOVE_CALL",
+  "GETGLOBAL_GETTABLE",
+  "GETTABLE_GETTABLE",
   NULL
 };
 
@@ -98,5 +110,29 @@ const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, OpArgN, OpArgN, iABC)		/* OP_CLOSE */
  ,opmode(0, 1, OpArgU, OpArgN, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARG */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QADD */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QSUB */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QMUL */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QDIV */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QMOD */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QPOW */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_QLT */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_QLE */
+ ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_MOVE_MOVE */
+ ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_MOVE_CALL */
+ ,opmode(0, 1, OpArgK, OpArgN, iABx)		/* OP_GETGLOBAL_GETTABLE */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETTABLE_GETTABLE */
+};
+
+
+const lu_byte luaP_opgeneric[NUM_OPCODES] = {
+  OP_MOVE, OP_LOADK, OP_LOADBOOL, OP_LOADNIL, OP_GETUPVAL, OP_GETGLOBAL,
+  OP_GETTABLE, OP_SETGLOBAL, OP_SETUPVAL, OP_SETTABLE, OP_NEWTABLE, OP_SELF,
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_UNM, OP_NOT, OP_LEN,
+  OP_CONCAT, OP_JMP, OP_EQ, OP_LT, OP_LE, OP_TEST, OP_TESTSET, OP_CALL,
+  OP_TAILCALL, OP_RETURN, OP_FORLOOP, OP_FORPREP, OP_TFORLOOP, OP_SETLIST,
+  OP_CLOSE, OP_CLOSURE, OP_VARARG,
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_LT, OP_LE,  /* OP_Q* */
+  OP_MOVE, OP_MOVE, OP_GETGLOBAL, OP_GETTABLE  /* superinstructions */
 };
 
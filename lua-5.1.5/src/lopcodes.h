@@ -204,11 +204,31 @@ OP_SETLIST,/*	A B C	R(A)[(C-1)*FPF+i] := R(A+i), 1 <= i <= B	*/
 OP_CLOSE,/*	A 	close all variables in the stack up to (>=) R(A)*/
 OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx], R(A), ... ,R(A+n))	*/
 
-OP_VARARG/*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
+OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
+
+/* quickened opcodes (see notes) */
+OP_QADD,/*	A B C	R(A) := RK(B) + RK(C)	(numbers)		*/
+OP_QSUB,/*	A B C	R(A) := RK(B) - RK(C)	(numbers)		*/
+OP_QMUL,/*	A B C	R(A) := RK(B) * RK(C)	(numbers)		*/
+OP_QDIV,/*	A B C	R(A) := RK(B) / RK(C)	(numbers)		*/
+OP_QMOD,/*	A B C	R(A) := RK(B) % RK(C)	(numbers)		*/
+OP_QPOW,/*	A B C	R(A) := RK(B) ^ RK(C)	(numbers)		*/
+OP_QLT,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++	(numbers)	*/
+OP_QLE,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++	(numbers)	*/
+
+/* superinstructions (see notes) */
+OP_MOVE_MOVE,/*	A B	R(A) := R(B); then the next OP_MOVE		*/
+OP_MOVE_CALL,/*	A B	R(A) := R(B); then the next OP_CALL		*/
+OP_GETGLOBAL_GETTABLE,/* A Bx	R(A) := Gbl[Kst(Bx)]; then the next OP_GETTABLE	*/
+OP_GETTABLE_GETTABLE/* A B C	R(A) := R(B)[RK(C)]; then the next OP_GETTABLE	*/
 } OpCode;
 
 /* 求操作码的个数 */
-#define NUM_OPCODES	(cast(int, OP_VARARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_GETTABLE_GETTABLE) + 1)
+
+
+/* opcode emitted by the compiler for a quickened or fused opcode */
+#define genericop(o)	(cast(OpCode, luaP_opgeneric[o]))
 
 
 
@@ -230,6 +250,17 @@ OP_VARARG/*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
       (true or false).
 
   (*) All `skips' (pc++) assume that next instruction is a jump
+
+  (*) The compiler never emits OP_Q* opcodes. luaV_execute rewrites a
+      generic arithmetic or order instruction in place into its OP_Q*
+      form once both operands are numbers, and back when they are not;
+      `string.dump' writes the generic form.
+
+  (*) OP_MOVE_MOVE .. OP_GETTABLE_GETTABLE are written by `luaK_fuse'
+      over the first instruction of a frequent pair (as counted with
+      LUA_TRACEPAIRS). The second instruction stays in place, so jumps
+      and debug information are unaffected; luaV_execute runs it without
+      an indirect dispatch. `string.dump' writes the generic form.
 ===========================================================================*/
 
 
@@ -251,6 +282,7 @@ enum OpArgMask {
 };
 
 LUAI_DATA const lu_byte luaP_opmodes[NUM_OPCODES];
+LUAI_DATA const lu_byte luaP_opgeneric[NUM_OPCODES];
 
 /*
 * enum OpMode {iABC, iABx, iAsBx};  * basic instruction format *
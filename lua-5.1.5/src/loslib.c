@@ -237,7 +237,6 @@ static const luaL_Reg syslib[] = {
 
 
 LUALIB_API int luaopen_os (lua_State *L) {
-  printf("debug: 5.luaopen_os\n");
   luaL_register(L, LUA_OSLIBNAME, syslib);
   return 1;
 }
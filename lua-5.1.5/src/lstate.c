@@ -6,6 +6,7 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
 #define lstate_c
 #define LUA_CORE
@@ -22,6 +23,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "ltrace.h"
 
 
 #define state_size(x)	(sizeof(x) + LUAI_EXTRASPACE)
@@ -29,6 +31,16 @@
 #define tostate(l)   (cast(lua_State *, cast(lu_byte *, l) + LUAI_EXTRASPACE))
 
 
+/*
+** a macro to help the creation of a unique random seed when a state is
+** created; it should give different values each time the program runs
+*/
+#if !defined(luai_makeseed)
+#include <time.h>
+#define luai_makeseed()		cast(unsigned int, time(NULL))
+#endif
+
+
 /*
 ** Main thread combines a thread state and the global state
 */
@@ -77,12 +89,15 @@ static void freestack (lua_State *L, lua_State *L1) {
 ** }
 */
 static void f_luaopen (lua_State *L, void *ud) {
-  printf("debug: in f_luaopen\n");
   global_State *g = G(L);
   UNUSED(ud);
   stack_init(L, L);  /* init stack */
+#if defined(LUA_SHAPES)
+  luaH_initshapes(L);
+#endif
   sethvalue(L, gt(L), luaH_new(L, 0, 2));  /* table of globals */
   sethvalue(L, registry(L), luaH_new(L, 0, 2));  /* registry */
+  g->tamt = luaH_new(L, 0, 0);  /* metatable for typed arrays */
   luaS_resize(L, MINSTRTABSIZE);  /* initial size of string table */
   luaT_init(L);
   luaX_init(L);
@@ -120,9 +135,13 @@ static void close_state (lua_State *L) {
   global_State *g = G(L);
   luaF_close(L, L->stack);  /* close all upvalues for this thread */
   luaC_freeall(L);  /* collect all objects */
+#if defined(LUA_SHAPES)
+  luaH_freeshapes(L);
+#endif
   lua_assert(g->rootgc == obj2gco(L));
   lua_assert(g->strt.nuse == 0);
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size, TString *);
+  luaM_freearray(L, G(L)->strt.oldhash, G(L)->strt.oldsize, TString *);
   luaZ_freebuffer(L, &g->buff);
   freestack(L, L);
   lua_assert(g->totalbytes == sizeof(LG));
@@ -163,6 +182,29 @@ void luaE_freethread (lua_State *L, lua_State *L1) {
 ** #define tostate(l)   (cast(lua_State *, cast(lu_byte *, l) + LUAI_EXTRASPACE))
 ** f其实是 static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize)
 */
+/*
+** Key of the string hash: mixes `luai_makeseed' with some addresses,
+** which change between runs where ASLR is on
+*/
+#define addbuff(b,p,e) \
+  { size_t t = cast(size_t, e); \
+    memcpy(buff + p, &t, sizeof(t)); p += sizeof(t); }
+
+static void makeseed (lua_State *L, lu_int32 *seed) {
+  static const lu_int32 k[2] = {0x9e3779b9u, 0x7f4a7c15u};
+  char buff[4 * sizeof(size_t)];
+  unsigned int h = luai_makeseed();
+  int p = 0;
+  addbuff(buff, p, L);  /* heap variable */
+  addbuff(buff, p, &h);  /* local variable */
+  addbuff(buff, p, luaO_nilobject);  /* global variable */
+  addbuff(buff, p, &lua_newstate);  /* public function */
+  lua_assert(p == sizeof(buff));
+  seed[0] = luaS_hash(buff, p, k) ^ cast(lu_int32, h);
+  seed[1] = luaS_hash(buff, p, seed);
+}
+
+
 LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   int i;
   lua_State *L;
@@ -186,6 +228,10 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->strt.size = 0;
   g->strt.nuse = 0;
   g->strt.hash = NULL;
+  g->strt.oldhash = NULL;
+  g->strt.oldsize = 0;
+  g->strt.moved = 0;
+  makeseed(L, g->seed);
   /* #define registry(L)  (&G(L)->l_registry) */
   setnilvalue(registry(L));
   luaZ_initbuffer(L, &g->buff);
@@ -202,8 +248,15 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->gcpause = LUAI_GCPAUSE;
   g->gcstepmul = LUAI_GCMUL;
   g->gcdept = 0;
+  luaR_init(L);
   /* NUM_TAGS = 9 */
   for (i=0; i<NUM_TAGS; i++) g->mt[i] = NULL;
+  g->tamt = NULL;
+  g->nextf = NULL;
+#if defined(LUA_SHAPES)
+  g->rootshape = NULL;
+  g->shapemark = 0;
+#endif
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != 0) {
     /* memory allocation error: free partial state */
     close_state(L);
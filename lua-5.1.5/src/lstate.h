@@ -11,6 +11,7 @@
 
 #include "lobject.h"
 #include "ltm.h"
+#include "ltrace.h"
 #include "lzio.h"
 
 
@@ -39,6 +40,9 @@ typedef struct stringtable {
   GCObject **hash;
   lu_int32 nuse;  /* number of elements */
   int size;
+  GCObject **oldhash;  /* previous vector while being resized, or NULL */
+  int oldsize;
+  int moved;  /* buckets of `oldhash' already moved to `hash' */
 } stringtable;
 
 
@@ -67,11 +71,12 @@ typedef struct CallInfo {
 */
 typedef struct global_State {
   stringtable strt;  /* hash table for strings */
+  lu_int32 seed[2];  /* key of the string hash (see lstring.c) */
   lua_Alloc frealloc;  /* function to reallocate memory lua_Alloc是lua内存分配函数原型 */
   void *ud;         /* auxiliary(辅助的，备用的) data to `frealloc' */
   lu_byte currentwhite;
   lu_byte gcstate;  /* state of garbage collector */
-  int sweepstrgc;  /* position of sweep in `strt' */
+  int sweepstrgc;  /* position of sweep in `strt' (`hash', then `oldhash') */
   GCObject *rootgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* position of sweep in `rootgc' */
   GCObject *gray;  /* list of gray objects */
@@ -90,8 +95,17 @@ typedef struct global_State {
   struct lua_State *mainthread;
   UpVal uvhead;  /* head of double-linked list of all open upvalues */
   struct Table *mt[NUM_TAGS];  /* metatables for basic types, NUM_TAGS = 9 */
+  struct Table *tamt;  /* metatable shared by all typed arrays */
+  lua_CFunction nextf;  /* see `lua_setnextfunction' */
+#if defined(LUA_SHAPES)
+  struct Shape *rootshape;  /* shape with no keys (see ltable.c) */
+  lu_byte shapemark;  /* mark of shapes in use in this cycle */
+#endif
   /* TM_INDEX = __index, TM_GC = __gc, TM_ADD = __add, ... */
   TString *tmname[TM_N];  /* array with tag-method names */
+#if defined(LUAI_TRACE)
+  TraceRing trace;  /* trace records of all threads */
+#endif
 } global_State;
 
 
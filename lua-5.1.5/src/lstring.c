@@ -18,38 +18,145 @@
 #include "lstring.h"
 
 
+/*
+** A resize does not rehash the whole table at once: the old vector is
+** kept in `oldhash' and its buckets are moved to the new one a few at a
+** time, as strings are created. Meanwhile a lookup checks both vectors
+** and new strings go to the new one.
+*/
+
+#define MOVESTEP	2  /* buckets moved for each new string */
+
+
+/* moves (at most) `n' buckets from `oldhash' to `hash' */
+static void movebuckets (lua_State *L, int n) {
+  stringtable *tb = &G(L)->strt;
+  if (G(L)->gcstate == GCSsweepstring)
+    return;  /* sweep must see each string once */
+  while (n-- > 0 && tb->moved < tb->oldsize) {
+    GCObject *p = tb->oldhash[tb->moved];
+    tb->oldhash[tb->moved++] = NULL;
+    while (p) {  /* for each node in the list */
+      GCObject *next = p->gch.next;  /* save next */
+      unsigned int h = gco2ts(p)->hash;
+      int h1 = lmod(h, tb->size);  /* new position */
+      lua_assert(cast_int(h%tb->size) == lmod(h, tb->size));
+      p->gch.next = tb->hash[h1];  /* chain it */
+      tb->hash[h1] = p;
+      p = next; //p后移
+    }
+  }
+  if (tb->moved == tb->oldsize) {  /* everything moved? */
+    luaM_freearray(L, tb->oldhash, tb->oldsize, TString *);
+    tb->oldhash = NULL;
+    tb->oldsize = tb->moved = 0;
+  }
+}
+
+
 void luaS_resize (lua_State *L, int newsize) {
   GCObject **newhash;
   stringtable *tb;
   int i;
   if (G(L)->gcstate == GCSsweepstring)
     return;  /* cannot resize during GC traverse 在垃圾回收阶段禁止重新分配全局stringtable大小*/
-  newhash = luaM_newvector(L, newsize, GCObject *);
   tb = &G(L)->strt; //tb指向旧的全局stringtable
+  if (tb->oldhash != NULL)  /* previous resize not finished? */
+    movebuckets(L, tb->oldsize);  /* finish it */
+  newhash = luaM_newvector(L, newsize, GCObject *);
   for (i=0; i<newsize; i++) newhash[i] = NULL;  //清空新的stringtable
-  /* rehash */
-  for (i=0; i<tb->size; i++) {
-    GCObject *p = tb->hash[i];
-    while (p) {  /* for each node in the list */
-      GCObject *next = p->gch.next;  /* save next */
-      unsigned int h = gco2ts(p)->hash;
-      int h1 = lmod(h, newsize);  /* new position */
-      lua_assert(cast_int(h%newsize) == lmod(h, newsize));
-      p->gch.next = newhash[h1];  /* chain it */
-      newhash[h1] = p;
-      p = next; //p后移
-    }
-  }
-  luaM_freearray(L, tb->hash, tb->size, TString *);
+  tb->oldhash = tb->hash;  /* its strings will be moved by `movebuckets' */
+  tb->oldsize = tb->size;
+  tb->moved = 0;
   tb->size = newsize;
   tb->hash = newhash;
+  movebuckets(L, 0);  /* frees an empty old vector */
 }
 
 
-static TString *newlstr (lua_State *L, const char *str, size_t l,
-                                       unsigned int h) {
+/*
+** Strings are hashed with HalfSipHash-1-3 (the 32-bit SipHash), keyed
+** by `G(L)->seed': every character counts, and without the seed no one
+** can build many strings with colliding hashes. (A CRC32 would be
+** faster with SSE4.2, but it is linear: strings of equal length that
+** collide do so under any seed.)
+*/
+
+#define rotl(x,n)	(((x) << (n)) | (((x) & 0xffffffffu) >> (32 - (n))))
+
+#define sipround(v0,v1,v2,v3) { \
+	v0 += v1; v1 = rotl(v1, 5); v1 ^= v0; v0 = rotl(v0, 16); \
+	v2 += v3; v3 = rotl(v3, 8); v3 ^= v2; \
+	v0 += v3; v3 = rotl(v3, 7); v3 ^= v0; \
+	v2 += v1; v1 = rotl(v1, 13); v1 ^= v2; v2 = rotl(v2, 16); }
+
+#define byteat(s,i)	cast(lu_int32, cast(unsigned char, (s)[i]))
+
+/* 4 chars as a little-endian word (compilers make it a single load) */
+#define load32(s)	(byteat(s, 0) | byteat(s, 1) << 8 | \
+			 byteat(s, 2) << 16 | byteat(s, 3) << 24)
+
+
+unsigned int luaS_hash (const char *str, size_t l, const lu_int32 *seed) {
+  lu_int32 v0 = seed[0];
+  lu_int32 v1 = seed[1];
+  lu_int32 v2 = 0x6c796765u ^ seed[0];
+  lu_int32 v3 = 0x74656462u ^ seed[1];
+  lu_int32 b = cast(lu_int32, l) << 24;
+  for (; l >= 4; l -= 4, str += 4) {
+    lu_int32 m = load32(str);
+    v3 ^= m;
+    sipround(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+  switch (l) {  /* last 0-3 chars */
+    case 3: b |= byteat(str, 2) << 16;  /* go through */
+    case 2: b |= byteat(str, 1) << 8;  /* go through */
+    case 1: b |= byteat(str, 0);
+  }
+  v3 ^= b;
+  sipround(v0, v1, v2, v3);
+  v0 ^= b;
+  v2 ^= 0xff;
+  sipround(v0, v1, v2, v3);
+  sipround(v0, v1, v2, v3);
+  sipround(v0, v1, v2, v3);
+  return cast(unsigned int, (v1 ^ v3) & 0xffffffffu);
+}
+
+
+/*
+** A long string gets its hash only when it is used as a table key (see
+** ltable.c), with no access to its state; so, at creation, its `hash'
+** keeps the part of the seed that will key it.
+*/
+#define longseed(g)	((g)->seed[0] ^ (g)->seed[1])
+
+unsigned int luaS_hashlong (TString *s) {
+  if (!(s->tsv.kind & STRHASHED)) {
+    lu_int32 seed[2];
+    seed[0] = s->tsv.hash;
+    seed[1] = ~s->tsv.hash;
+    s->tsv.hash = luaS_hash(getstr(s), s->tsv.len, seed);
+    s->tsv.kind |= STRHASHED;
+  }
+  return s->tsv.hash;
+}
+
+
+/* `a' is a long string */
+int luaS_eqlong (const TString *a, const TString *b) {
+  size_t len = a->tsv.len;
+  lua_assert(islongstr(a));
+  return (a == b) ||  /* same instance or... */
+    (len == b->tsv.len &&  /* equal length and... */
+     memcmp(getstr(a), getstr(b), len) == 0);  /* equal contents */
+}
+
+
+static TString *createstr (lua_State *L, const char *str, size_t l,
+                           lu_byte kind, unsigned int h) {
   TString *ts;
-  stringtable *tb;
   if (l+1 > (MAX_SIZET - sizeof(TString))/sizeof(char))
     luaM_toobig(L);
   ts = cast(TString *, luaM_malloc(L, (l+1)*sizeof(char)+sizeof(TString)));
@@ -58,30 +165,32 @@ static TString *newlstr (lua_State *L, const char *str, size_t l,
   ts->tsv.marked = luaC_white(G(L));
   ts->tsv.tt = LUA_TSTRING;
   ts->tsv.reserved = 0;
+  ts->tsv.kind = kind;
   memcpy(ts+1, str, l*sizeof(char));
   ((char *)(ts+1))[l] = '\0';  /* ending 0 */
-  tb = &G(L)->strt;
+  return ts;
+}
+
+
+static TString *newlstr (lua_State *L, const char *str, size_t l,
+                                       unsigned int h) {
+  TString *ts = createstr(L, str, l, 0, h);
+  stringtable *tb = &G(L)->strt;
   h = lmod(h, tb->size);
   ts->tsv.next = tb->hash[h];  /* chain new entry */
   tb->hash[h] = obj2gco(ts);
   tb->nuse++;
+  if (tb->oldhash != NULL)  /* being resized? */
+    movebuckets(L, MOVESTEP);
   if (tb->nuse > cast(lu_int32, tb->size) && tb->size <= MAX_INT/2)
     luaS_resize(L, tb->size*2);  /* too crowded */
   return ts;
 }
 
 
-TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
-  GCObject *o;
-  //size_t在x64平台下是8Btye，而int仍然是4Byte。
-  unsigned int h = cast(unsigned int, l);  /* seed */
-  size_t step = (l>>5)+1;  /* if string is too long, don't hash all its chars */
-  size_t l1;
-  for (l1=l; l1>=step; l1-=step)  /* compute hash */
-    h = h ^ ((h<<5)+(h>>2)+cast(unsigned char, str[l1-1]));
-  for (o = G(L)->strt.hash[lmod(h, G(L)->strt.size)];
-       o != NULL;
-       o = o->gch.next) {
+/* string equal to `str' in list `o', or NULL */
+static TString *findstr (lua_State *L, GCObject *o, const char *str, size_t l) {
+  for (; o != NULL; o = o->gch.next) {
     TString *ts = rawgco2ts(o);
     //判断字符串是否存在
     if (ts->tsv.len == l && (memcmp(str, getstr(ts), l) == 0)) {
@@ -90,7 +199,73 @@ TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
       return ts;
     }
   }
-  return newlstr(L, str, l, h);  /* not found */
+  return NULL;
+}
+
+
+TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
+  stringtable *tb = &G(L)->strt;
+  TString *ts;
+  unsigned int h;
+  if (l > LUAI_MAXSHORTLEN) {  /* long string? not interned */
+    TString *ts = createstr(L, str, l, STRLONG, longseed(G(L)));
+    luaC_link(L, obj2gco(ts), LUA_TSTRING);
+    return ts;
+  }
+  //size_t在x64平台下是8Btye，而int仍然是4Byte。
+  h = luaS_hash(str, l, G(L)->seed);
+  ts = findstr(L, tb->hash[lmod(h, tb->size)], str, l);
+  if (ts == NULL && tb->oldhash != NULL)  /* maybe not moved yet */
+    ts = findstr(L, tb->oldhash[lmod(h, tb->oldsize)], str, l);
+  return (ts != NULL) ? ts : newlstr(L, str, l, h);
+}
+
+
+/*
+** A string whose contents stay in the embedder's buffer `s', where
+** `s[l]' must be '\0'. When the string is collected, `freef' (unless
+** NULL) is called as a deallocation, freef(ud, s, l + 1, 0); it must
+** not call Lua. Short strings are still copied and interned, and then
+** `s' is released at once. A buffer from the state's own allocator is
+** adopted: its bytes count in `totalbytes' like any other block, so they
+** pace the collector. If this raises an error, `s' is still the caller's.
+*/
+TString *luaS_newext (lua_State *L, const char *s, size_t l,
+                      lua_Alloc freef, void *ud) {
+  TString *ts;
+  if (l <= LUAI_MAXSHORTLEN) {
+    ts = luaS_newlstr(L, s, l);
+    if (freef) (*freef)(ud, cast(void *, s), l + 1, 0);
+    return ts;
+  }
+  ts = cast(TString *, luaM_malloc(L, sizeof(TString) + sizeof(ExtString)));
+  ts->tsv.len = l;
+  ts->tsv.hash = longseed(G(L));
+  ts->tsv.reserved = 0;
+  ts->tsv.kind = STRLONG | STREXT;
+  extstr(ts)->s = s;
+  extstr(ts)->freef = freef;
+  extstr(ts)->ud = ud;
+  if (freef == G(L)->frealloc && ud == G(L)->ud) {
+    ts->tsv.kind |= STROWNED;
+    G(L)->totalbytes += l + 1;
+  }
+  luaC_link(L, obj2gco(ts), LUA_TSTRING);
+  return ts;
+}
+
+
+void luaS_freestr (lua_State *L, TString *ts) {
+  if (!islongstr(ts))
+    G(L)->strt.nuse--;  /* only short strings are in `strt' */
+  else if (ts->tsv.kind & STREXT) {
+    ExtString *e = extstr(ts);
+    if (ts->tsv.kind & STROWNED)
+      luaM_freemem(L, cast(void *, e->s), ts->tsv.len + 1);
+    else if (e->freef)
+      (*e->freef)(e->ud, cast(void *, e->s), ts->tsv.len + 1, 0);
+  }
+  luaM_freemem(L, ts, sizestring(&ts->tsv));
 }
 
 
@@ -101,6 +276,7 @@ Udata *luaS_newudata (lua_State *L, size_t s, Table *e) {
   u = cast(Udata *, luaM_malloc(L, s + sizeof(Udata)));
   u->uv.marked = luaC_white(G(L));  /* is not finalized */
   u->uv.tt = LUA_TUSERDATA;
+  u->uv.istarray = 0;
   u->uv.len = s;
   u->uv.metatable = NULL;
   u->uv.env = e;
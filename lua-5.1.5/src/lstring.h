@@ -13,7 +13,8 @@
 #include "lstate.h"
 
 
-#define sizestring(s)	(sizeof(union TString)+((s)->len+1)*sizeof(char))
+#define sizestring(s)	(sizeof(union TString) + (((s)->kind & STREXT) ? \
+			 sizeof(ExtString) : ((s)->len+1)*sizeof(char)))
 
 #define sizeudata(u)	(sizeof(union Udata)+(u)->len)
 
@@ -23,9 +24,27 @@
 
 #define luaS_fix(s)	l_setbit((s)->tsv.marked, FIXEDBIT)
 
+#define islongstr(s)	((s)->tsv.kind & STRLONG)
+
+/* hash of string `s', computing it if needed */
+#define luaS_hashof(s) \
+	(((s)->tsv.kind & (STRLONG|STRHASHED)) == STRLONG ? \
+	 luaS_hashlong(s) : (s)->tsv.hash)
+
+/* equality of strings: only long ones can be equal at different addresses */
+#define luaS_eqstr(a,b) \
+	((a) == (b) || (islongstr(a) && luaS_eqlong(a, b)))
+
+LUAI_FUNC unsigned int luaS_hash (const char *str, size_t l,
+                                  const lu_int32 *seed);
+LUAI_FUNC unsigned int luaS_hashlong (TString *s);
+LUAI_FUNC int luaS_eqlong (const TString *a, const TString *b);
 LUAI_FUNC void luaS_resize (lua_State *L, int newsize);
 LUAI_FUNC Udata *luaS_newudata (lua_State *L, size_t s, Table *e);
 LUAI_FUNC TString *luaS_newlstr (lua_State *L, const char *str, size_t l);
+LUAI_FUNC TString *luaS_newext (lua_State *L, const char *s, size_t l,
+                                lua_Alloc freef, void *ud);
+LUAI_FUNC void luaS_freestr (lua_State *L, TString *ts);
 
 
 #endif
@@ -16,6 +16,8 @@
 ** in its main position (i.e. the `original' position that its hash gives
 ** to it), then the colliding element is in its own main position.
 ** Hence even when the load factor reaches 100%, performance remains good.
+** (With LUA_SWISSTABLE the hash part is an open-addressing table instead;
+** see below.)
 */
 
 #include <math.h>
@@ -32,6 +34,7 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
+#include "lstring.h"
 #include "ltable.h"
 
 
@@ -46,10 +49,259 @@
 
 #define MAXASIZE	(1 << MAXBITS)
 
+
+/* frozen tables (see `luaH_freeze') reject every change */
+#define checkfrozen(L,t) \
+  { if ((t)->frozen) luaG_runerror(L, "attempt to modify a frozen table"); }
+
+
+/*
+** number of ints inside a lua_Number
+*/
+#define numints		cast_int(sizeof(lua_Number)/sizeof(int))
+
+
+#if defined(LUA_SWISSTABLE)
+
+/*
+** {=============================================================
+** Open-addressing hash part
+** ==============================================================
+*/
+
+/*
+** Besides `node', the hash part has a vector `ctrl' with one control
+** byte per node: CTRL_EMPTY for a free node, or 7 bits of the hash of
+** its key. Nodes are probed in aligned groups of GROUPSIZE: a lookup
+** compares the control bytes of a whole group against the hash bits at
+** once, looks only at the keys of matching nodes, and stops at the first
+** group with a free node. As with chained tables, a key stays in its
+** node until the next rehash even when its value becomes nil (or the key
+** dies), so no node ever becomes free again and there are no
+** tombstones; `next' and the collector walk `node' exactly as before.
+** `nfree' counts the keys that still fit; when it reaches 0 the table is
+** rehashed. It keeps the load factor at most 7/8 in tables larger than
+** one group; smaller tables use the first sizenode(t) bytes of a single
+** group and may fill up.
+*/
+
+#define GROUPSIZE	16
+#define CTRL_EMPTY	0x80
+
+/* log2 of the number of groups */
+#define lsizegroups(t)	((t)->lsizenode > 4 ? (t)->lsizenode - 4 : 0)
+
+/* control bytes in use inside each group */
+#define groupmask(t)	\
+	((t)->lsizenode >= 4 ? 0xffffu : (1u << sizenode(t)) - 1)
+
+#define maxload(size)	((size) < GROUPSIZE ? (size) : (size) - (size)/8)
+
+/* node vector and control bytes live in one block */
+#define nodevecsize(size)  \
+	((size)*sizeof(Node) + ((size) < GROUPSIZE ? GROUPSIZE : (size)))
+
+
+/*
+** spread the bits of a raw hash over 32 bits; the top 7 bits are the
+** control byte and the bits just below them choose the first group
+*/
+#define mixhash(h)	\
+	((cast(lu_int32, (h) ^ ((h) >> 16)) * 2654435769u) & 0xffffffffu)
+#define ctrlbits(m)		cast_int((m) >> 25)
+#define firstgroup(m,lg)	(cast_int((m) >> (25 - (lg))) & (twoto(lg) - 1))
+
+
+/*
+** matchbyte(g, c) returns a mask with bit i set when the control byte
+** g[i] equals c; matchempty(g) does the same for free nodes
+*/
+#if defined(__SSE2__) && !defined(LUA_ANSI)
+
+#include <emmintrin.h>
+
+static unsigned int matchbyte (const lu_byte *g, int c) {
+  __m128i v = _mm_loadu_si128(cast(const __m128i *, g));
+  return cast(unsigned int,
+              _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(cast(char, c)))));
+}
+
+static unsigned int matchempty (const lu_byte *g) {
+  /* CTRL_EMPTY is the only control byte with its high bit set */
+  return cast(unsigned int,
+              _mm_movemask_epi8(_mm_loadu_si128(cast(const __m128i *, g))));
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__) && !defined(LUA_ANSI)
+
+#include <arm_neon.h>
+
+static unsigned int tomask (uint8x16_t v) {
+  static const lu_byte weights[GROUPSIZE] =
+    {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t m = vandq_u8(v, vld1q_u8(weights));
+  return cast(unsigned int, vaddv_u8(vget_low_u8(m))) |
+         (cast(unsigned int, vaddv_u8(vget_high_u8(m))) << 8);
+}
+
+static unsigned int matchbyte (const lu_byte *g, int c) {
+  return tomask(vceqq_u8(vld1q_u8(g), vdupq_n_u8(cast_byte(c))));
+}
+
+static unsigned int matchempty (const lu_byte *g) {
+  return tomask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(g)), vdupq_n_s8(0)));
+}
+
+#else
+
+static unsigned int matchbyte (const lu_byte *g, int c) {
+  unsigned int m = 0;
+  int i;
+  for (i = GROUPSIZE - 1; i >= 0; i--)
+    m = (m << 1) | (g[i] == c);
+  return m;
+}
+
+static unsigned int matchempty (const lu_byte *g) {
+  return matchbyte(g, CTRL_EMPTY);
+}
+
+#endif
+
+
+/* index of the lowest bit set in a (non-zero) mask */
+#if defined(__GNUC__)
+#define lowbit(m)	__builtin_ctz(m)
+#else
+static int lowbit (unsigned int m) {
+  int i = 0;
+  while (!(m & 1)) { m >>= 1; i++; }
+  return i;
+}
+#endif
+
+
+/*
+** runs `body' for each node `n' of `t' whose control byte matches the
+** (mixed) hash `m', in probe order; groups follow a triangular sequence,
+** which visits all of them
+*/
+#define forcandidates(t,m,n,body) {  \
+  int lg_ = lsizegroups(t);  \
+  int g_ = firstgroup(m, lg_);  \
+  int step_ = 0;  \
+  unsigned int gm_ = groupmask(t);  \
+  for (;;) {  \
+    const lu_byte *cg_ = (t)->ctrl + g_*GROUPSIZE;  \
+    unsigned int hit_ = matchbyte(cg_, ctrlbits(m)) & gm_;  \
+    while (hit_) {  \
+      Node *n = gnode(t, g_*GROUPSIZE + lowbit(hit_));  \
+      body  \
+      hit_ &= hit_ - 1;  \
+    }  \
+    if ((matchempty(cg_) & gm_) || ++step_ == twoto(lg_)) break;  \
+    g_ = (g_ + step_) & (twoto(lg_) - 1);  \
+  } }
+
+
+#define dummynode		(&dummynode_)
+#define dummyctrl		(dummyctrl_)
+
+static const Node dummynode_ = {
+  {NILCONSTANT},  /* value */
+  {{NILCONSTANT}}  /* key */
+};
+
+static const lu_byte dummyctrl_[GROUPSIZE] = {
+  CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY,
+  CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY,
+  CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY,
+  CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY, CTRL_EMPTY
+};
+
+
+/*
+** raw hash for lua_Numbers; an integer is its own raw hash
+*/
+static unsigned int hashnum (lua_Number n) {
+  unsigned int a[numints];
+  int i;
+  lua_number2int(i, n);
+  if (luai_numeq(cast_num(i), n))  /* integer key? (this includes -0) */
+    return cast(unsigned int, i);
+  memcpy(a, &n, sizeof(a));
+  for (i = 1; i < numints; i++) a[0] += a[i];
+  return a[0];
+}
+
+
+static lu_int32 hashkey (const TValue *key) {
+  switch (ttype(key)) {
+    case LUA_TNUMBER:
+      return mixhash(hashnum(nvalue(key)));
+    case LUA_TSTRING:
+      return mixhash(luaS_hashof(rawtsvalue(key)));
+    case LUA_TBOOLEAN:
+      return mixhash(cast(unsigned int, bvalue(key)));
+    case LUA_TLIGHTUSERDATA:
+      return mixhash(IntPoint(pvalue(key)));
+    default:
+      return mixhash(IntPoint(gcvalue(key)));
+  }
+}
+
+
+static Node *intnode (const Table *t, int k) {
+  lu_int32 m = mixhash(cast(unsigned int, k));
+  lua_Number nk = cast_num(k);
+  forcandidates(t, m, n,
+    if (ttisnumber(gkey(n)) && luai_numeq(nvalue(gkey(n)), nk))
+      return n;
+  )
+  return NULL;
+}
+
+
+static Node *strnode (const Table *t, TString *key) {
+  lu_int32 m = mixhash(luaS_hashof(key));
+  forcandidates(t, m, n,
+    if (ttisstring(gkey(n)) && luaS_eqstr(key, rawtsvalue(gkey(n))))
+      return n;
+  )
+  return NULL;
+}
+
+
+static Node *keynode (const Table *t, const TValue *key) {
+  lu_int32 m = hashkey(key);
+  forcandidates(t, m, n,
+    if (luaO_rawequalObj(key2tval(n), key))
+      return n;
+  )
+  return NULL;
+}
+
+
+/* same as `keynode', but also finds `key' if it is already dead */
+static Node *nextnode (const Table *t, const TValue *key) {
+  lu_int32 m = hashkey(key);
+  forcandidates(t, m, n,
+    if (luaO_rawequalObj(key2tval(n), key) ||
+          (ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) &&
+           gcvalue(gkey(n)) == gcvalue(key)))
+      return n;
+  )
+  return NULL;
+}
+
+/* }============================================================= */
+
+#else
+
 //sizenode(t)为散列表的长度
 #define hashpow2(t,n)      (gnode(t, lmod((n), sizenode(t))))
   
-#define hashstr(t,str)  hashpow2(t, (str)->tsv.hash)
+#define hashstr(t,str)  hashpow2(t, luaS_hashof(str))
 #define hashboolean(t,p)        hashpow2(t, p)
 
 
@@ -66,19 +318,19 @@
 
 #define hashpointer(t,p)	hashmod(t, IntPoint(p))
 
-
 /*
-** number of ints inside a lua_Number
+** integer keys are hashed by value, with no detour through the bits of
+** a double: consecutive keys get consecutive nodes, and the odd modulus
+** still spreads strided ones
 */
-#define numints		cast_int(sizeof(lua_Number)/sizeof(int))
-
+#define hashint(t,k)	hashmod(t, cast(unsigned int, k))
 
 
 #define dummynode		(&dummynode_)
 
 static const Node dummynode_ = {
-  {{NULL}, LUA_TNIL},  /* value */
-  {{{NULL}, LUA_TNIL, NULL}}  /* key */
+  {NILCONSTANT},  /* value */
+  {{NILCONSTANT, NULL}}  /* key */
 };
 
 
@@ -92,12 +344,14 @@ static const Node dummynode_ = {
 ** gnode(t, 3    % ( (8 -1)|1 )
 ** gnode(t, 3)
 ** 该函数的作用是，为所有类型为lua_Numbers的关键字，在散列表部分确定索引位置。
+** (integer values, including -0, go to `hashint' instead)
 */
 static Node *hashnum (const Table *t, lua_Number n) {
   unsigned int a[numints];
   int i;
-  if (luai_numeq(n, 0))  /* avoid problems with -0 */
-    return gnode(t, 0);
+  lua_number2int(i, n);
+  if (luai_numeq(cast_num(i), n))  /* integer key? */
+    return hashint(t, i);
   memcpy(a, &n, sizeof(a));
   for (i = 1; i < numints; i++) a[0] += a[i];
   return hashmod(t, a[0]);
@@ -148,6 +402,304 @@ static Node *mainposition (const Table *t, const TValue *key) {
 */
 }
 
+static Node *intnode (const Table *t, int k) {
+  lua_Number nk = cast_num(k);
+  Node *n = hashint(t, k);
+  do {  /* check whether `key' is somewhere in the chain */
+    if (ttisnumber(gkey(n)) && luai_numeq(nvalue(gkey(n)), nk))
+      return n;  /* that's it */
+    else n = gnext(n);
+  } while (n);
+  return NULL;
+}
+
+
+static Node *strnode (const Table *t, TString *key) {
+  Node *n = hashstr(t, key);
+  do {  /* check whether `key' is somewhere in the chain */
+    if (ttisstring(gkey(n)) && luaS_eqstr(key, rawtsvalue(gkey(n))))
+      return n;  /* that's it */
+    else n = gnext(n);
+  } while (n);
+  return NULL;
+}
+
+
+static Node *keynode (const Table *t, const TValue *key) {
+  Node *n = mainposition(t, key);
+  do {  /* check whether `key' is somewhere in the chain */
+    if (luaO_rawequalObj(key2tval(n), key))
+      return n;  /* that's it */
+    else n = gnext(n);
+  } while (n);
+  return NULL;
+}
+
+
+/* same as `keynode', but also finds `key' if it is already dead */
+static Node *nextnode (const Table *t, const TValue *key) {
+  Node *n = mainposition(t, key);
+  do {  /* check whether `key' is somewhere in the chain */
+    if (luaO_rawequalObj(key2tval(n), key) ||
+          (ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) &&
+           gcvalue(gkey(n)) == gcvalue(key)))
+      return n;
+    else n = gnext(n);
+  } while (n);
+  return NULL;
+}
+
+#endif
+
+
+/*
+** {=============================================================
+** Frozen tables
+** ==============================================================
+*/
+
+/*
+** `luaH_freeze' gives the hash part of a table a perfect hash (hash and
+** displace): keys are spread over sizedisp(t) buckets, and `t->disp'
+** keeps for each bucket either the displacement `d' that sends its keys
+** to distinct nodes when mixed into their hashes or, for a bucket with a
+** single key, -(i+1) where `i' is the node of that key. A lookup reads
+** one entry of `disp' and then checks exactly one node, with either
+** layout of the hash part. With about two keys per bucket `disp' stays
+** small enough to be cached.
+*/
+
+#define MAXBUCKET	32  /* give up when a bucket gets more keys */
+#define MAXDISP		4096  /* give up when no displacement below it works */
+
+/* the `lg' high bits of a 32-bit product */
+#define topbits(x,lg)	cast_int((((x) & 0xffffffffu) >> (31 - (lg))) >> 1)
+
+#define bucketof(t,h)	topbits(cast(lu_int32, h) * 0x9e3779b1u, lsizedisp(t))
+#define dispslot(t,h,d)	\
+	cast_int(mix32(cast(lu_int32, h) ^ cast(lu_int32, d) * 0x9e3779b1u) & \
+	         (sizenode(t) - 1))
+
+
+/* final mix of MurmurHash3 */
+static lu_int32 mix32 (lu_int32 h) {
+  h ^= (h & 0xffffffffu) >> 16;
+  h *= 0x85ebca6bu;
+  h ^= (h & 0xffffffffu) >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= (h & 0xffffffffu) >> 16;
+  return h;
+}
+
+
+static lu_int32 numhash (lua_Number n) {
+  unsigned int a[numints];
+  int i;
+  if (luai_numeq(n, 0))  /* avoid problems with -0 */
+    return 0;
+  memcpy(a, &n, sizeof(a));
+  for (i = 1; i < numints; i++) a[0] = a[0] * 0x9e3779b1u + a[i];
+  return a[0];
+}
+
+
+/*
+** short strings are hashed by address, as they are internalized; long
+** ones need their contents
+*/
+#define strhash(s) \
+	(islongstr(s) ? cast(lu_int32, luaS_hashof(s)) : cast(lu_int32, IntPoint(s)))
+
+static lu_int32 keyhash (const TValue *key) {
+  switch (ttype(key)) {
+    case LUA_TSTRING: return strhash(rawtsvalue(key));
+    case LUA_TNUMBER: return numhash(nvalue(key));
+    case LUA_TBOOLEAN: return cast(lu_int32, bvalue(key));
+    case LUA_TLIGHTUSERDATA: return cast(lu_int32, IntPoint(pvalue(key)));
+    default: return cast(lu_int32, IntPoint(gcvalue(key)));
+  }
+}
+
+
+static int frozenslot (const Table *t, lu_int32 h) {
+  int d = t->disp[bucketof(t, h)];
+  return (d < 0) ? -d - 1 : dispslot(t, h, d);
+}
+
+
+static Node *frozennum (const Table *t, lua_Number nk) {
+  Node *n = gnode(t, frozenslot(t, numhash(nk)));
+  return (ttisnumber(gkey(n)) && luai_numeq(nvalue(gkey(n)), nk)) ? n : NULL;
+}
+
+
+static Node *frozenstr (const Table *t, TString *key) {
+  Node *n = gnode(t, frozenslot(t, strhash(key)));
+  return (ttisstring(gkey(n)) && luaS_eqstr(key, rawtsvalue(gkey(n)))) ? n : NULL;
+}
+
+
+/* also finds `key' if it is already dead, as `nextnode' */
+static Node *frozenkey (const Table *t, const TValue *key) {
+  Node *n = gnode(t, frozenslot(t, keyhash(key)));
+  if (luaO_rawequalObj(key2tval(n), key) ||
+        (ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) &&
+         gcvalue(gkey(n)) == gcvalue(key)))
+    return n;
+  return NULL;
+}
+
+/* }============================================================= */
+
+
+#if defined(LUA_SHAPES)
+
+/*
+** {=============================================================
+** Shapes
+** ==============================================================
+*/
+
+/*
+** A table whose hash part holds only short string keys keeps them in a
+** `shape' instead: `t->shape->keys' lists them in insertion order and
+** `t->slots[i]' is the value of `keys[i]', while `node' stays empty.
+** Tables that get the same keys in the same order share one shape.
+** Shapes form a tree rooted at `G(L)->rootshape' (no keys), where each
+** shape adds one key to its parent. A key is never removed from a
+** shape; as in a node, its value just becomes nil. The hash part
+** leaves the shape for `node' when `rehash' finds that it must also
+** hold other keys, which happens with the first key that is not a
+** short string or with the LUAI_MAXSHAPE+1-th one.
+** Shapes are not collectable: the collector marks the shapes of the
+** tables it traverses, together with their keys, and `luaH_sweepshapes'
+** frees the others.
+*/
+
+#define sizeshape(n)	(sizeof(Shape) + ((n) > 1 ? (n) - 1 : 0) * sizeof(TString *))
+
+
+static int shapeindex (const Shape *s, const TString *key) {
+  int i;
+  for (i = 0; i < s->nkeys; i++)
+    if (s->keys[i] == key) return i;
+  return -1;
+}
+
+
+static int numuseshape (const Table *t) {
+  int i = t->shape->nkeys;
+  int n = 0;
+  while (i--)
+    if (!ttisnil(&t->slots[i])) n++;
+  return n;
+}
+
+
+static Shape *newshape (lua_State *L, Shape *parent, TString *key) {
+  int n = (parent != NULL) ? parent->nkeys + 1 : 0;
+  Shape *s = cast(Shape *, luaM_malloc(L, sizeshape(n)));
+  s->parent = parent;
+  s->kids = NULL;
+  s->nkeys = n;
+  s->marked = cast_byte(G(L)->shapemark - 1);  /* not in use */
+  if (parent != NULL) {
+    memcpy(s->keys, parent->keys, parent->nkeys * sizeof(TString *));
+    s->keys[parent->nkeys] = key;
+    s->sibling = parent->kids;
+    parent->kids = s;
+  }
+  else
+    s->sibling = NULL;
+  return s;
+}
+
+
+/* the shape of `s' plus `key'; recently used kids are kept first */
+static Shape *addkey (lua_State *L, Shape *s, TString *key) {
+  Shape **p;
+  for (p = &s->kids; *p != NULL; p = &(*p)->sibling) {
+    Shape *k = *p;
+    if (k->keys[s->nkeys] == key) {
+      *p = k->sibling;  /* move it to the front */
+      k->sibling = s->kids;
+      s->kids = k;
+      return k;
+    }
+  }
+  return newshape(L, s, key);
+}
+
+
+/* adds `key' (not present) to a table with a shape */
+static TValue *shapekey (lua_State *L, Table *t, TString *key) {
+  Shape *s = addkey(L, t->shape, key);
+  if (s->nkeys > t->sizeslots) {  /* no room for its value? */
+    int n = (t->sizeslots < 2) ? 4 : 2*t->sizeslots;
+    if (n > LUAI_MAXSHAPE) n = LUAI_MAXSHAPE;
+    luaM_reallocvector(L, t->slots, t->sizeslots, n, TValue);
+    t->sizeslots = n;
+  }
+  t->shape = s;
+  if (isblack(obj2gco(t)))  /* already traversed? */
+    luaC_barrierback(L, t);  /* collector must mark the new shape */
+  setnilvalue(&t->slots[s->nkeys - 1]);
+  return &t->slots[s->nkeys - 1];
+}
+
+
+static void freeshapes (lua_State *L, Shape *s) {
+  while (s != NULL) {
+    Shape *next = s->sibling;
+    freeshapes(L, s->kids);
+    luaM_freemem(L, s, sizeshape(s->nkeys));
+    s = next;
+  }
+}
+
+
+/* frees the kids of `s' not marked in use (nor can their kids be) */
+static void sweepkids (lua_State *L, Shape *s, lu_byte mark) {
+  Shape **p = &s->kids;
+  while (*p != NULL) {
+    Shape *k = *p;
+    if (k->marked != mark) {
+      *p = k->sibling;
+      k->sibling = NULL;
+      freeshapes(L, k);
+    }
+    else {
+      sweepkids(L, k, mark);
+      p = &k->sibling;
+    }
+  }
+}
+
+
+void luaH_initshapes (lua_State *L) {
+  G(L)->rootshape = newshape(L, NULL, NULL);
+}
+
+
+/*
+** called by the collector once marking is over: shapes not marked are
+** used by no live table, and their keys may be about to be collected
+*/
+void luaH_sweepshapes (lua_State *L) {
+  global_State *g = G(L);
+  sweepkids(L, g->rootshape, g->shapemark);
+}
+
+
+void luaH_freeshapes (lua_State *L) {
+  freeshapes(L, G(L)->rootshape);
+  G(L)->rootshape = NULL;
+}
+
+/* }============================================================= */
+
+#endif
+
 
 /*
 ** returns the index for `key' if `key' is an appropriate key to live in
@@ -180,42 +732,118 @@ static int findindex (lua_State *L, Table *t, StkId key) {
   i = arrayindex(key);
   if (0 < i && i <= t->sizearray)  /* is `key' inside array part? */
     return i-1;  /* yes; that's the index (corrected to C) */
+#if defined(LUA_SHAPES)
+  else if (t->shape != NULL) {  /* hash part is in a shape? */
+    if (!ttisstring(key) || (i = shapeindex(t->shape, rawtsvalue(key))) < 0)
+      luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
+    return i + t->sizearray;
+  }
+#endif
   else {
-    Node *n = mainposition(t, key);
-    do {  /* check whether `key' is somewhere in the chain */
-      /* key may be dead already, but it is ok to use it in `next' */
-      if (luaO_rawequalObj(key2tval(n), key) ||
-            (ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) &&
-             gcvalue(gkey(n)) == gcvalue(key))) {
-        i = cast_int(n - gnode(t, 0));  /* key index in hash table */
-        /* hash elements are numbered after array ones */
-        return i + t->sizearray;
-      }
-      else n = gnext(n);
-    } while (n);
-    luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
-    return 0;  /* to avoid warnings */
+    /* key may be dead already, but it is ok to use it in `next' */
+    Node *n = (t->disp != NULL) ? frozenkey(t, key) : nextnode(t, key);
+    if (n != NULL)
+      i = cast_int(n - gnode(t, 0));  /* key index in hash table */
+    else if (t->oldhash != NULL && (n = nextnode(t->oldhash, key)) != NULL)
+      i = sizenode(t) + cast_int(n - gnode(t->oldhash, 0));  /* numbered last */
+    else
+      luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
+    /* hash elements are numbered after array ones */
+    return i + t->sizearray;
   }
 }
 
 
-int luaH_next (lua_State *L, Table *t, StkId key) {
-  int i = findindex(L, t, key);  /* find original element */
+/*
+** puts in `key' and `key+1' the first element after the one with index
+** `i' (see `findindex') and returns its index, or -1 if there is none
+*/
+static int nextfrom (lua_State *L, Table *t, int i, StkId key) {
   for (i++; i < t->sizearray; i++) {  /* try first array part */
     if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
       setnvalue(key, cast_num(i+1));
       setobj2s(L, key+1, &t->array[i]);
-      return 1;
+      return i;
+    }
+  }
+#if defined(LUA_SHAPES)
+  if (t->shape != NULL) {  /* then the shape */
+    for (i -= t->sizearray; i < t->shape->nkeys; i++) {
+      if (!ttisnil(&t->slots[i])) {
+        setsvalue2s(L, key, t->shape->keys[i]);
+        setobj2s(L, key+1, &t->slots[i]);
+        return i + t->sizearray;
+      }
     }
+    return -1;
   }
+#endif
   for (i -= t->sizearray; i < sizenode(t); i++) {  /* then hash part */
     if (!ttisnil(gval(gnode(t, i)))) {  /* a non-nil value? */
       setobj2s(L, key, key2tval(gnode(t, i)));
       setobj2s(L, key+1, gval(gnode(t, i)));
-      return 1;
+      return i + t->sizearray;
+    }
+  }
+  if (t->oldhash != NULL) {  /* then what was not moved yet */
+    Table *old = t->oldhash;
+    for (i -= sizenode(t); i < old->sizearray; i++) {
+      if (!ttisnil(gval(gnode(old, i)))) {
+        setobj2s(L, key, key2tval(gnode(old, i)));
+        setobj2s(L, key+1, gval(gnode(old, i)));
+        return i + sizenode(t) + t->sizearray;
+      }
     }
   }
-  return 0;  /* no more elements */
+  return -1;  /* no more elements */
+}
+
+
+int luaH_next (lua_State *L, Table *t, StkId key) {
+  return nextfrom(L, t, findindex(L, t, key), key) >= 0;
+}
+
+
+/* true if node `n' has key `key' (maybe dead already, as in `nextnode') */
+#define samekey(n,key) \
+	(luaO_rawequalObj(key2tval(n), key) || \
+	 (ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) && \
+	  gcvalue(gkey(n)) == gcvalue(key)))
+
+
+/* true if `key' (not nil) is the key of the element with index `i' */
+static int iskeyat (const Table *t, const TValue *key, int i) {
+  if (i < 0) return 0;
+  if (i < t->sizearray)
+    return ttisnumber(key) && luai_numeq(nvalue(key), cast_num(i+1));
+  i -= t->sizearray;
+#if defined(LUA_SHAPES)
+  if (t->shape != NULL)
+    return i < t->shape->nkeys && ttisstring(key) &&
+           rawtsvalue(key) == t->shape->keys[i];
+#endif
+  if (i < sizenode(t))
+    return samekey(gnode(t, i), key);
+  i -= sizenode(t);
+  return t->oldhash != NULL && i < t->oldhash->sizearray &&
+         samekey(gnode(t->oldhash, i), key);
+}
+
+
+/*
+** `luaH_next' for a traversal that keeps in `cursor' the index of the
+** element it returned last: while `key' is still found there, the next
+** element is reached with no search at all
+*/
+int luaH_nextcursor (lua_State *L, Table *t, StkId key, int *cursor) {
+  int i;
+  if (ttisnil(key)) i = -1;  /* first iteration */
+  else if (iskeyat(t, key, *cursor)) i = *cursor;
+  else i = findindex(L, t, key);
+  i = nextfrom(L, t, i, key);
+  if (i < 0) return 0;
+  *cursor = i;
+  return 1;
 }
 
 
@@ -343,6 +971,10 @@ static int numusehash (const Table *t, int *nums, int *pnasize) {
       totaluse++;
     }
   }
+#if defined(LUA_SHAPES)
+  if (t->shape != NULL)
+    totaluse += numuseshape(t);  /* all strings: nothing to add to `nums' */
+#endif
   *pnasize += ause;
   return totaluse;
 }
@@ -359,6 +991,58 @@ static void setarrayvector (lua_State *L, Table *t, int size /* new array size *
   t->sizearray = size;
 }
 
+#if defined(LUA_SWISSTABLE)
+
+static void setnodevector (lua_State *L, Table *t, int size /* new hash size */) {
+  int lsize;
+  if (size == 0) {  /* no elements to hash part? */
+    t->node = cast(Node *, dummynode);  /* use common `dummynode' */
+    t->ctrl = cast(lu_byte *, dummyctrl);
+    t->nfree = 0;
+    lsize = 0;
+  }
+  else {
+    int i;
+    lsize = ceillog2(size);
+    if (size > maxload(twoto(lsize)))  /* keep the load factor */
+      lsize++;
+    if (lsize > MAXBITS)
+      luaG_runerror(L, "table overflow");
+    size = twoto(lsize);
+    t->node = cast(Node *, luaM_malloc(L, nodevecsize(size)));
+    t->ctrl = cast(lu_byte *, t->node + size);
+    for (i=0; i<size; i++) {
+      Node *n = gnode(t, i);
+      setnilvalue(gkey(n));
+      setnilvalue(gval(n));
+    }
+    memset(t->ctrl, CTRL_EMPTY, size < GROUPSIZE ? GROUPSIZE : size);
+    t->nfree = maxload(size);
+  }
+  t->lsizenode = cast_byte(lsize);
+}
+
+
+static void freenodevector (lua_State *L, Node *node, int lsize) {
+  if (node != dummynode)
+    luaM_freemem(L, node, nodevecsize(twoto(lsize)));
+}
+
+
+static void clearnodevector (Table *t) {
+  int i;
+  int size = sizenode(t);
+  for (i=0; i<size; i++) {
+    Node *n = gnode(t, i);
+    setnilvalue(gkey(n));
+    setnilvalue(gval(n));
+  }
+  memset(t->ctrl, CTRL_EMPTY, size < GROUPSIZE ? GROUPSIZE : size);
+  t->nfree = maxload(size);
+}
+
+#else
+
 /*
 ** #define twoto(x) (1<<(x))
 ** #define gnode(t,i) (&(t)->node[i])
@@ -389,6 +1073,27 @@ static void setnodevector (lua_State *L, Table *t, int size /* new hash size */)
   t->lastfree = gnode(t, size);  /* all positions are free */
 }
 
+
+static void freenodevector (lua_State *L, Node *node, int lsize) {
+  if (node != dummynode)
+    luaM_freearray(L, node, twoto(lsize), Node);
+}
+
+
+static void clearnodevector (Table *t) {
+  int i;
+  int size = sizenode(t);
+  for (i=0; i<size; i++) {
+    Node *n = gnode(t, i);
+    gnext(n) = NULL;
+    setnilvalue(gkey(n));
+    setnilvalue(gval(n));
+  }
+  t->lastfree = gnode(t, size);  /* all positions are free */
+}
+
+#endif
+
 /*
 ** #define setobjt2t  setobj
 ** #define setobj(L,obj1,obj2) \
@@ -396,17 +1101,78 @@ static void setnodevector (lua_State *L, Table *t, int size /* new hash size */)
 **    o1->value = o2->value; o1->tt=o2->tt; \
 **    checkliveness(G(L),o1); }
 */
+/*
+** {=============================================================
+** Incremental rehash
+** ==============================================================
+*/
+
+/*
+** When the hash part of a big table must be resized but its array part
+** keeps its size, the old hash part is not reinserted at once: it is
+** kept aside in `t->oldhash', and each new key added to the table first
+** moves LUAI_REHASHSTEP of its nodes into the new hash part. Lookups
+** that miss in the new part also search the old one, `next' and the
+** collector walk both, and a node is cleared when it is moved, so each
+** key is always in exactly one of them. `oldhash' is a bare Table
+** (not a collectable object) used only for its hash part; its
+** `sizearray' counts the nodes still to be moved, from the top down.
+*/
+
+static void freeoldhash (lua_State *L, Table *old) {
+  freenodevector(L, old->node, old->lsizenode);
+  luaM_free(L, old);
+}
+
+
+/* set aside the current hash part of `t' and give it an empty one */
+static void startmigration (lua_State *L, Table *t, int nhsize) {
+  Table *old = luaM_new(L, Table);
+  *old = *t;  /* same hash part */
+  old->metatable = NULL;
+  old->array = NULL;
+  old->oldhash = NULL;
+  old->sizearray = sizenode(old);  /* all nodes to be moved */
+  setnodevector(L, t, 0);  /* `t' owns `old' (with all its nodes) ... */
+  t->oldhash = old;
+  setnodevector(L, t, nhsize);  /* ... before an allocation can fail */
+}
+
+
+/* }============================================================= */
+
+
 static void resize (lua_State *L, Table *t, int nasize, int nhsize) {
   int i;
   int oldasize = t->sizearray;
   int oldhsize = t->lsizenode;
   Node *nold = t->node;  /* save old hash ... */
+  Table *oldhash = t->oldhash;  /* ... and a hash part still being moved */
+#if defined(LUA_SHAPES)
+  Shape *shape = NULL;  /* shape being left */
+  TValue *slots = t->slots;
+  int sizeslots = t->sizeslots;
+  if (t->shape != NULL) {
+    if (nhsize > numuseshape(t))  /* other keys go to the hash part? */
+      shape = t->shape;
+    else
+      nhsize = 0;  /* keep the shape */
+  }
+#endif
+  t->oldhash = NULL;
   if (nasize > oldasize)  /* array part must grow? */
     setarrayvector(L, t, nasize); //新的数组部分包括原来的数据，加上新分配的空间
   /* create new hash part with appropriate size
   ** 为新的散列表部分分配空间，新的散列表部分不包括原来的数据，全部置为空
   */
   setnodevector(L, t, nhsize); 
+#if defined(LUA_SHAPES)
+  if (shape != NULL) {
+    t->shape = NULL;
+    t->slots = NULL;
+    t->sizeslots = 0;
+  }
+#endif
   /* 如果新数组的大小小于旧数组的大小 */
   if (nasize < oldasize) {  /* array part must shrink? */
     t->sizearray = nasize;
@@ -430,13 +1196,31 @@ static void resize (lua_State *L, Table *t, int nasize, int nhsize) {
       setobjt2t(L, luaH_set(L, t, key2tval(old)), gval(old));
   }
   /* 释放掉原散列表的空间 */
-  if (nold != dummynode)
-    luaM_freearray(L, nold, twoto(oldhsize), Node);  /* free old array */
+  freenodevector(L, nold, oldhsize);  /* free old array */
+  if (oldhash != NULL) {  /* re-insert what was not moved yet */
+    for (i = oldhash->sizearray - 1; i >= 0; i--) {
+      Node *old = gnode(oldhash, i);
+      if (!ttisnil(gval(old)))
+        setobjt2t(L, luaH_set(L, t, key2tval(old)), gval(old));
+    }
+    freeoldhash(L, oldhash);
+  }
+#if defined(LUA_SHAPES)
+  if (shape != NULL) {  /* re-insert the keys of the shape */
+    for (i = 0; i < shape->nkeys; i++) {
+      if (!ttisnil(&slots[i]))
+        setobjt2t(L, luaH_setstr(L, t, shape->keys[i]), &slots[i]);
+    }
+    luaM_freearray(L, slots, sizeslots, TValue);
+  }
+#endif
 }
 
 
 void luaH_resizearray (lua_State *L, Table *t, int nasize) {
   int nsize = (t->node == dummynode) ? 0 : sizenode(t);
+  if (t->oldhash != NULL)
+    nsize += t->oldhash->sizearray;
   resize(L, t, nasize, nsize);
 }
 
@@ -455,13 +1239,19 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
   nasize = numusearray(t, nums);  /* count keys in array part */
   totaluse = nasize;  /* all those keys are integer keys 数组部分的key全是整型的*/
   totaluse += numusehash(t, nums, &nasize);  /* count keys in hash part */
+  if (t->oldhash != NULL)
+    totaluse += numusehash(t->oldhash, nums, &nasize);
   /* count extra key */
   nasize += countint(ek, nums);
   totaluse++;
   /* compute new size for array part */
   na = computesizes(nums, &nasize);
   /* resize the table to new computed sizes */
-  resize(L, t, nasize, totaluse - na);
+  if (t->oldhash == NULL && nasize == t->sizearray &&
+      t->node != dummynode && sizenode(t) >= LUAI_INCRHASHSIZE)
+    startmigration(L, t, totaluse - na);  /* move nodes a few at a time */
+  else
+    resize(L, t, nasize, totaluse - na);
 }
 
 
@@ -479,21 +1269,273 @@ Table *luaH_new (lua_State *L, int narray, int nhash) {
   /* temporary values (kept only if some malloc fails) */
   t->array = NULL;
   t->sizearray = 0;
+  t->border = 0;
   t->lsizenode = 0;
   t->node = cast(Node *, dummynode);
+  t->oldhash = NULL;
+  t->frozen = 0;
+  t->disp = NULL;
+#if defined(LUA_SWISSTABLE)
+  t->ctrl = cast(lu_byte *, dummyctrl);
+  t->nfree = 0;
+#endif
+#if defined(LUA_SHAPES)
+  t->shape = NULL;
+  t->slots = NULL;
+  t->sizeslots = 0;
+#endif
   setarrayvector(L, t, narray);
+#if defined(LUA_SHAPES)
+  if (G(L)->rootshape != NULL && nhash <= LUAI_MAXSHAPE) {  /* use a shape? */
+    t->slots = luaM_newvector(L, nhash, TValue);
+    t->sizeslots = nhash;
+    t->shape = G(L)->rootshape;
+    nhash = 0;
+  }
+#endif
   setnodevector(L, t, nhash);
   return t;
 }
 
 
-void luaH_free (lua_State *L, Table *t) {
+/*
+** removes all elements of `t' but keeps its array and hash parts, so
+** that it can be refilled without any reallocation or rehash
+*/
+void luaH_clear (lua_State *L, Table *t) {
+  int i;
+  checkfrozen(L, t);
+  if (t->oldhash != NULL) {
+    freeoldhash(L, t->oldhash);
+    t->oldhash = NULL;
+  }
+  for (i=0; i<t->sizearray; i++)
+    setnilvalue(&t->array[i]);
+  if (t->node != dummynode)
+    clearnodevector(t);
+#if defined(LUA_SHAPES)
+  if (t->shape != NULL) {
+    for (i=0; i<t->shape->nkeys; i++)
+      setnilvalue(&t->slots[i]);
+    t->shape = G(L)->rootshape;
+  }
+#endif
+  t->border = 0;
+}
+
+
+/*
+** copies elements f..e of `a1' to positions t.. of `a2', as raw gets and
+** sets would do (from the end when the ranges overlap that way). When
+** both ranges lie in array parts, that is a single memmove. The caller
+** ensures that neither e-f nor t+(e-f) overflows.
+*/
+void luaH_move (lua_State *L, Table *a1, int f, int e, int t, Table *a2) {
+  int n = e - f;  /* number of elements, minus 1 */
+  checkfrozen(L, a2);
+  if (n < 0) return;
+  if (f >= 1 && e <= a1->sizearray && t >= 1 && n < a2->sizearray - t + 1) {
+    memmove(&a2->array[t-1], &a1->array[f-1], (n+1)*sizeof(TValue));
+    if (a1 != a2 && isblack(obj2gco(a2)))
+      luaC_barrierback(L, a2);  /* some values may be white */
+  }
+  else {
+    int up = (a1 == a2 && t > f && t <= e);  /* must copy from the end? */
+    int i;
+    for (i = 0; i <= n; i++) {
+      int k = up ? n - i : i;
+      TValue v;  /* `luaH_setnum' may move the source */
+      setobj(L, &v, luaH_getnum(a1, f + k));
+      setobjt2t(L, luaH_setnum(L, a2, t + k), &v);
+      luaC_barriert(L, a2, &v);
+    }
+  }
+}
+
+
+/*
+** finds a displacement that sends all keys of a bucket (chained through
+** `next') to distinct free slots, and reserves these slots in `owner';
+** returns -1 if there is none
+*/
+static int finddisp (const Table *t, int head, const int *next, int *owner) {
+  int d;
+  for (d = 0; d < MAXDISP; d++) {
+    int i, j;
+    for (i = head; i >= 0; i = next[i]) {
+      int s = dispslot(t, keyhash(key2tval(gnode(t, i))), d);
+      if (owner[s] >= 0) break;  /* slot already taken */
+      owner[s] = i;
+    }
+    if (i < 0) return d;  /* all keys placed */
+    for (j = head; j != i; j = next[j])  /* undo this attempt */
+      owner[dispslot(t, keyhash(key2tval(gnode(t, j))), d)] = -1;
+  }
+  return -1;
+}
+
+
+/*
+** moves every node of `t' to the slot given by a perfect hash and
+** returns its displacement vector; returns NULL (with `t' untouched)
+** if no perfect hash was found
+*/
+static int *perfecthash (lua_State *L, Table *t) {
+  int m = sizenode(t);
+  int r = sizedisp(t);
+  int *disp = luaM_newvector(L, 2*(r+m), int);  /* and auxiliary vectors */
+  int *size = disp + r;  /* number of keys in each bucket */
+  int *next = disp + 2*r;  /* next key in the same bucket */
+  int *owner = disp + 2*r + m;  /* node to be moved to each slot */
+  int i, b, s, free, maxsize = 0;
+  for (b = 0; b < r; b++) {
+    disp[b] = -1;  /* bucket lists start empty */
+    size[b] = 0;
+  }
+  for (i = 0; i < m; i++) owner[i] = -1;
+  for (i = 0; i < m; i++) {  /* put each key in its bucket */
+    if (!ttisnil(gval(gnode(t, i)))) {
+      b = bucketof(t, keyhash(key2tval(gnode(t, i))));
+      next[i] = disp[b];
+      disp[b] = i;
+      if (++size[b] > maxsize) maxsize = size[b];
+    }
+  }
+  for (s = maxsize; s > 1; s--) {  /* place biggest buckets first */
+    for (b = 0; b < r; b++) {
+      if (size[b] == s &&
+          (maxsize > MAXBUCKET ||  /* too many collisions? */
+           (disp[b] = finddisp(t, disp[b], next, owner)) < 0)) {
+        luaM_freearray(L, disp, 2*(r+m), int);
+        return NULL;
+      }
+    }
+  }
+  free = 0;
+  for (b = 0; b < r; b++) {
+    if (size[b] == 1) {  /* single keys go straight to the free slots */
+      while (owner[free] >= 0) free++;
+      owner[free] = disp[b];
+      disp[b] = -(free + 1);
+    }
+    else if (size[b] == 0)
+      disp[b] = 0;  /* anything will do */
+  }
+  /* compute the destination of each node (kept in `next')... */
+  for (i = 0; i < m; i++) next[i] = -1;
+  for (s = 0; s < m; s++)
+    if (owner[s] >= 0) next[owner[s]] = s;
+  free = 0;
+  for (i = 0; i < m; i++) {
+    if (next[i] < 0) {  /* empty node? take any slot left */
+      while (owner[free] >= 0) free++;
+      next[i] = free++;
+    }
+  }
+  /* ... and move them there, one cycle of the permutation at a time */
+  for (i = 0; i < m; i++) {
+    while (next[i] != i) {
+      int j = next[i];
+      Node aux = *gnode(t, i);
+      *gnode(t, i) = *gnode(t, j);
+      *gnode(t, j) = aux;
+      next[i] = next[j];
+      next[j] = j;
+    }
+  }
+#if !defined(LUA_SWISSTABLE)
+  for (i = 0; i < m; i++) gnext(gnode(t, i)) = NULL;  /* chains are gone */
+  t->lastfree = gnode(t, 0);  /* no free positions */
+#endif
+  luaM_reallocvector(L, disp, 2*(r+m), r, int);
+  return disp;
+}
+
+
+/*
+** makes `t' read only. It is first resized to fit its contents exactly
+** and then its hash part gets a perfect hash, so that every key is found
+** with a single probe. If there is no perfect hash (for instance because
+** some distinct keys share a hash value), the usual layout is kept.
+*/
+void luaH_freeze (lua_State *L, Table *t) {
+  int nasize, na;
+  int nums[MAXBITS+1];
+  int i;
+  int totaluse;
+  if (t->frozen) return;
+  for (i=0; i<=MAXBITS; i++) nums[i] = 0;
+  nasize = numusearray(t, nums);
+  totaluse = nasize;
+  totaluse += numusehash(t, nums, &nasize);
+  if (t->oldhash != NULL)
+    totaluse += numusehash(t->oldhash, nums, &nasize);
+  na = computesizes(nums, &nasize);
+  resize(L, t, nasize, totaluse - na);
   if (t->node != dummynode)
-    luaM_freearray(L, t->node, sizenode(t), Node);
+    t->disp = perfecthash(L, t);
+  t->frozen = 1;
+}
+
+
+void luaH_free (lua_State *L, Table *t) {
+  if (t->oldhash != NULL)
+    freeoldhash(L, t->oldhash);
+  if (t->disp != NULL)
+    luaM_freearray(L, t->disp, sizedisp(t), int);
+  freenodevector(L, t->node, t->lsizenode);
   luaM_freearray(L, t->array, t->sizearray, TValue);
+#if defined(LUA_SHAPES)
+  luaM_freearray(L, t->slots, t->sizeslots, TValue);
+#endif
   luaM_free(L, t);
 }
 
+#if defined(LUA_SWISSTABLE)
+
+/*
+** inserts a new key into a hash table: it goes to the first free node
+** along its probe sequence. Nodes are never freed, so if the collector
+** has marked `key' dead in some node (because its value was nil), that
+** node must be reused; otherwise `key' would be in two nodes and `next'
+** could find the wrong one.
+*/
+static TValue *newkey (lua_State *L, Table *t, const TValue *key) {
+  lu_int32 m = hashkey(key);
+  int lg, g, step, i;
+  unsigned int free;
+  Node *n;
+  if (iscollectable(key)) {
+    forcandidates(t, m, n,
+      if (ttype(gkey(n)) == LUA_TDEADKEY && gcvalue(gkey(n)) == gcvalue(key)) {
+        setobj2t(L, key2tval(n), key);
+        luaC_barriert(L, t, key);
+        lua_assert(ttisnil(gval(n)));
+        return gval(n);
+      }
+    )
+  }
+  if (t->nfree == 0) {  /* no room left? */
+    rehash(L, t, key);  /* grow table */
+    return luaH_set(L, t, key);  /* re-insert key into grown table */
+  }
+  lg = lsizegroups(t);
+  g = firstgroup(m, lg);
+  step = 0;
+  while ((free = matchempty(t->ctrl + g*GROUPSIZE) & groupmask(t)) == 0)
+    g = (g + ++step) & (twoto(lg) - 1);
+  i = g*GROUPSIZE + lowbit(free);
+  t->ctrl[i] = cast_byte(ctrlbits(m));
+  t->nfree--;
+  n = gnode(t, i);
+  setobj2t(L, key2tval(n), key);
+  luaC_barriert(L, t, key);
+  lua_assert(ttisnil(gval(n)));
+  return gval(n);
+}
+
+#else
+
 /*
 ** 注意此函数会导致表t的lastfree指针前移，这说明了，在表t中新增关键字Node时，
 ** 会直接拿散列数组末尾的节点，不会重新分配一个节点空间。
@@ -546,12 +1588,41 @@ static TValue *newkey (lua_State *L, Table *t, const TValue *key) {
       mp = n;
     }
   }
-  gkey(mp)->value = key->value; gkey(mp)->tt = key->tt;
+  setobj2t(L, key2tval(mp), key);
   luaC_barriert(L, t, key);
   lua_assert(ttisnil(gval(mp)));
   return gval(mp);
 }
 
+#endif
+
+
+/* moves (at most) `n' nodes from the old hash part to the new one */
+static void migrate (lua_State *L, Table *t, int n) {
+  while (n-- > 0 && t->oldhash != NULL) {
+    Table *old = t->oldhash;
+    Node *o;
+    if (old->sizearray == 0) {  /* everything moved? */
+      t->oldhash = NULL;
+      freeoldhash(L, old);
+      break;
+    }
+    o = gnode(old, old->sizearray - 1);
+    if (!ttisnil(gval(o))) {
+      TValue k;
+      TValue *v;
+      setobj2t(L, &k, key2tval(o));  /* `o' may go away in a rehash */
+      v = newkey(L, t, &k);
+      if (t->oldhash != old)  /* table was rehashed? */
+        continue;  /* then `o' was already reinserted (and freed) */
+      setobjt2t(L, v, gval(o));
+      setnilvalue(gval(o));
+    }
+    setnilvalue(gkey(o));  /* no lookup may find a node already passed */
+    old->sizearray--;
+  }
+}
+
 
 /*
 ** search function for integers
@@ -569,14 +1640,10 @@ const TValue *luaH_getnum (Table *t, int key) {
     **  在散列表部分查看key为number且key值等于nk的node节点，
     **  找到后返回该节点key对应的value值的指针
     */
-    lua_Number nk = cast_num(key);
-    Node *n = hashnum(t, nk);
-    do {  /* check whether `key' is somewhere in the chain */
-      if (ttisnumber(gkey(n)) && luai_numeq(nvalue(gkey(n)), nk))
-        return gval(n);  /* that's it */
-      else n = gnext(n);
-    } while (n);
-    return luaO_nilobject;
+    Node *n = (t->disp != NULL) ? frozennum(t, cast_num(key)) : intnode(t, key);
+    if (n == NULL && (t->oldhash == NULL || (n = intnode(t->oldhash, key)) == NULL))
+      return luaO_nilobject;
+    return gval(n);
   }
 /*
 **  #define gkey(n)    (&(n)->i_key.nk)
@@ -593,13 +1660,39 @@ const TValue *luaH_getnum (Table *t, int key) {
 **  在表t中查找字符串类型key
 */
 const TValue *luaH_getstr (Table *t, TString *key) {
-  Node *n = hashstr(t, key); //通过key的hash值找出mainposition
-  do {  /* check whether `key' is somewhere in the chain */
-    if (ttisstring(gkey(n)) && rawtsvalue(gkey(n)) == key)
-      return gval(n);  /* that's it */
-    else n = gnext(n);
-  } while (n);
-  return luaO_nilobject;
+  Node *n;
+#if defined(LUA_SHAPES)
+  if (t->shape != NULL) {
+    int i = shapeindex(t->shape, key);
+    return (i < 0) ? luaO_nilobject : &t->slots[i];
+  }
+#endif
+  n = (t->disp != NULL) ? frozenstr(t, key) : strnode(t, key);
+  if (n == NULL && (t->oldhash == NULL || (n = strnode(t->oldhash, key)) == NULL))
+    return luaO_nilobject;
+  return gval(n);
+}
+
+
+/*
+** same as `luaH_getstr', but also stores in `slot' the index of the
+** node where `key' was found (to feed the inline caches of lvm.c)
+*/
+const TValue *luaH_getstrslot (Table *t, TString *key, int *slot) {
+  Node *n;
+#if defined(LUA_SHAPES)
+  if (t->shape != NULL) {  /* `slot' is then an index into `t->slots' */
+    int i = shapeindex(t->shape, key);
+    if (i < 0) return luaO_nilobject;
+    *slot = i;
+    return &t->slots[i];
+  }
+#endif
+  n = (t->disp != NULL) ? frozenstr(t, key) : strnode(t, key);
+  if (n == NULL)  /* not cached when found in `oldhash' */
+    return (t->oldhash == NULL) ? luaO_nilobject : luaH_getstr(t->oldhash, key);
+  *slot = cast_int(n - t->node);
+  return gval(n);
 }
 
 
@@ -620,20 +1713,19 @@ const TValue *luaH_get (Table *t, const TValue *key) {
       /* else go through */
     }
     default: {
-      Node *n = mainposition(t, key);
-      do {  /* check whether `key' is somewhere in the chain */
-        if (luaO_rawequalObj(key2tval(n), key))
-          return gval(n);  /* that's it */
-        else n = gnext(n);
-      } while (n);
-      return luaO_nilobject;
+      Node *n = (t->disp != NULL) ? frozenkey(t, key) : keynode(t, key);
+      if (n == NULL && (t->oldhash == NULL || (n = keynode(t->oldhash, key)) == NULL))
+        return luaO_nilobject;
+      return gval(n);
     }
   }
 }
 
 
 TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
-  const TValue *p = luaH_get(t, key);
+  const TValue *p;
+  checkfrozen(L, t);
+  p = luaH_get(t, key);
   t->flags = 0;
   if (p != luaO_nilobject)
     return cast(TValue *, p);
@@ -641,30 +1733,46 @@ TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
     if (ttisnil(key)) luaG_runerror(L, "table index is nil");
     else if (ttisnumber(key) && luai_numisnan(nvalue(key)))
       luaG_runerror(L, "table index is NaN");
+#if defined(LUA_SHAPES)
+    if (t->shape != NULL && ttisstring(key) && !islongstr(rawtsvalue(key)) &&
+        t->shape->nkeys < LUAI_MAXSHAPE)
+      return shapekey(L, t, rawtsvalue(key));
+#endif
+    if (t->oldhash != NULL) migrate(L, t, LUAI_REHASHSTEP);
     return newkey(L, t, key);
   }
 }
 
 
 TValue *luaH_setnum (lua_State *L, Table *t, int key) {
-  const TValue *p = luaH_getnum(t, key);
+  const TValue *p;
+  checkfrozen(L, t);
+  p = luaH_getnum(t, key);
   if (p != luaO_nilobject)
     return cast(TValue *, p);
   else {
     TValue k;
     setnvalue(&k, cast_num(key));
+    if (t->oldhash != NULL) migrate(L, t, LUAI_REHASHSTEP);
     return newkey(L, t, &k);
   }
 }
 
 
 TValue *luaH_setstr (lua_State *L, Table *t, TString *key) {
-  const TValue *p = luaH_getstr(t, key);
+  const TValue *p;
+  checkfrozen(L, t);
+  p = luaH_getstr(t, key);
   if (p != luaO_nilobject)
     return cast(TValue *, p);
   else {
     TValue k;
+#if defined(LUA_SHAPES)
+    if (t->shape != NULL && !islongstr(key) && t->shape->nkeys < LUAI_MAXSHAPE)
+      return shapekey(L, t, key);
+#endif
     setsvalue(L, &k, key);  //设置k的tt值以及value值
+    if (t->oldhash != NULL) migrate(L, t, LUAI_REHASHSTEP);
     return newkey(L, t, &k);//将k插入表t中
   }
 }
@@ -705,7 +1813,7 @@ static int unbound_search (Table *t, unsigned int j) {
 ** 先在数组部分找边界：判断数组最后一个元素是否是nil，如果不是，存在边界值，二分查找法在数组部分查找
 ** 数组部分不存在边界，那么在散列表部分查找
 */
-int luaH_getn (Table *t) {
+static int getn (Table *t) {
   unsigned int j = t->sizearray;
   if (j > 0 && ttisnil(&t->array[j - 1])) {
     /* there is a boundary in the array part: (binary) search for it */
@@ -724,12 +1832,39 @@ int luaH_getn (Table *t) {
 }
 
 
+/* is `b' a boundary of `t'? */
+static int isborder (Table *t, int b) {
+  return (b == 0 || !ttisnil(luaH_getnum(t, b))) &&
+         (b == MAX_INT || ttisnil(luaH_getnum(t, b+1)));
+}
+
+
+/*
+** The last boundary found is kept in `t->border'. Appending to or
+** removing from the end of a sequence moves the boundary by one, so
+** checking the hint and its neighbours makes `#t' constant time in
+** these loops; only when they all fail is a boundary searched for.
+*/
+int luaH_getn (Table *t) {
+  int b = t->border;
+  if (!isborder(t, b)) {
+    if (isborder(t, b+1)) b++;  /* t[#t+1] = v */
+    else if (b > 0 && isborder(t, b-1)) b--;  /* t[#t] = nil */
+    else b = getn(t);
+    t->border = b;
+  }
+  return b;
+}
+
+
 
 #if defined(LUA_DEBUG)
 
+#if !defined(LUA_SWISSTABLE)
 Node *luaH_mainposition (const Table *t, const TValue *key) {
   return mainposition(t, key);
 }
+#endif
 
 int luaH_isdummy (Node *n) { return n == dummynode; }
 
@@ -13,26 +13,46 @@
 #define gnode(t,i)	(&(t)->node[i])
 #define gkey(n)		(&(n)->i_key.nk)
 #define gval(n)		(&(n)->i_val)
+#if !defined(LUA_SWISSTABLE)
 #define gnext(n)	((n)->i_key.nk.next)
+#endif
 
 #define key2tval(n)	(&(n)->i_key.tvk)
 
+/* size of the displacement vector of a frozen table (see ltable.c) */
+#define lsizedisp(t)	((t)->lsizenode > 1 ? (t)->lsizenode - 1 : 0)
+#define sizedisp(t)	twoto(lsizedisp(t))
+
 
 LUAI_FUNC const TValue *luaH_getnum (Table *t, int key);
 LUAI_FUNC TValue *luaH_setnum (lua_State *L, Table *t, int key);
 LUAI_FUNC const TValue *luaH_getstr (Table *t, TString *key);
+LUAI_FUNC const TValue *luaH_getstrslot (Table *t, TString *key, int *slot);
 LUAI_FUNC TValue *luaH_setstr (lua_State *L, Table *t, TString *key);
 LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_set (lua_State *L, Table *t, const TValue *key);
 LUAI_FUNC Table *luaH_new (lua_State *L, int narray, int lnhash);
 LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, int nasize);
+LUAI_FUNC void luaH_clear (lua_State *L, Table *t);
+LUAI_FUNC void luaH_move (lua_State *L, Table *a1, int f, int e, int t,
+                                        Table *a2);
+LUAI_FUNC void luaH_freeze (lua_State *L, Table *t);
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
+LUAI_FUNC int luaH_nextcursor (lua_State *L, Table *t, StkId key,
+                                             int *cursor);
 LUAI_FUNC int luaH_getn (Table *t);
+#if defined(LUA_SHAPES)
+LUAI_FUNC void luaH_initshapes (lua_State *L);
+LUAI_FUNC void luaH_sweepshapes (lua_State *L);
+LUAI_FUNC void luaH_freeshapes (lua_State *L);
+#endif
 
 
 #if defined(LUA_DEBUG)
+#if !defined(LUA_SWISSTABLE)
 LUAI_FUNC Node *luaH_mainposition (const Table *t, const TValue *key);
+#endif
 LUAI_FUNC int luaH_isdummy (Node *n);
 #endif
 
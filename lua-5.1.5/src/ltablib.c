@@ -5,6 +5,7 @@
 */
 
 
+#include <limits.h>
 #include <stddef.h>
 
 #define ltablib_c
@@ -69,6 +70,53 @@ static int maxn (lua_State *L) {
 }
 
 
+static int tnew (lua_State *L) {
+  int narr = luaL_optint(L, 1, 0);
+  int nrec = luaL_optint(L, 2, 0);
+  luaL_argcheck(L, narr >= 0, 1, "negative size");
+  luaL_argcheck(L, nrec >= 0, 2, "negative size");
+  lua_createtable(L, narr, nrec);
+  return 1;
+}
+
+
+static int tclear (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_cleartable(L, 1);
+  return 0;
+}
+
+
+static int tfreeze (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_freezetable(L, 1);
+  lua_settop(L, 1);
+  return 1;  /* return the table itself */
+}
+
+
+/*
+** table.move(a1, f, e, t [,a2]): a2[t..] = a1[f..e], with raw accesses;
+** returns a2 (which defaults to a1)
+*/
+static int tmove (lua_State *L) {
+  int f = luaL_checkint(L, 2);
+  int e = luaL_checkint(L, 3);
+  int t = luaL_checkint(L, 4);
+  int tt = !lua_isnoneornil(L, 5) ? 5 : 1;  /* destination table */
+  luaL_checktype(L, 1, LUA_TTABLE);
+  luaL_checktype(L, tt, LUA_TTABLE);
+  if (e >= f) {  /* otherwise, nothing to move */
+    luaL_argcheck(L, f > 0 || e < INT_MAX + f, 3,
+                  "too many elements to move");
+    luaL_argcheck(L, t <= INT_MAX - (e - f), 4, "destination wrap around");
+    lua_rawmove(L, 1, f, e, t, tt);
+  }
+  lua_pushvalue(L, tt);
+  return 1;
+}
+
+
 static int getn (lua_State *L) {
   lua_pushinteger(L, aux_getn(L, 1));
   return 1;
@@ -96,12 +144,12 @@ static int tinsert (lua_State *L) {
       break;
     }
     case 3: {
-      int i;
       pos = luaL_checkint(L, 2);  /* 2nd argument is the position */
       if (pos > e) e = pos;  /* `grow' array if necessary */
-      for (i = e; i > pos; i--) {  /* move up elements */
-        lua_rawgeti(L, 1, i-1);
-        lua_rawseti(L, 1, i);  /* t[i] = t[i-1] */
+      if (e > pos) {  /* move up elements */
+        lua_rawgeti(L, 1, e-1);
+        lua_rawseti(L, 1, e);  /* t[e] = t[e-1] (may grow the array part) */
+        lua_rawmove(L, 1, pos, e-2, pos+1, 1);  /* t[pos+1..e-1] = t[pos..e-2] */
       }
       break;
     }
@@ -122,10 +170,7 @@ static int tremove (lua_State *L) {
    return 0;  /* nothing to remove */
   luaL_setn(L, 1, e - 1);  /* t.n = n-1 */
   lua_rawgeti(L, 1, pos);  /* result = t[pos] */
-  for ( ;pos<e; pos++) {
-    lua_rawgeti(L, 1, pos+1);
-    lua_rawseti(L, 1, pos);  /* t[pos] = t[pos+1] */
-  }
+  lua_rawmove(L, 1, pos+1, e, pos, 1);  /* t[pos..e-1] = t[pos+1..e] */
   lua_pushnil(L);
   lua_rawseti(L, 1, e);  /* t[e] = nil */
   return 1;
@@ -267,12 +312,16 @@ static int sort (lua_State *L) {
 
 
 static const luaL_Reg tab_funcs[] = {
+  {"clear", tclear},
   {"concat", tconcat},
   {"foreach", foreach},
   {"foreachi", foreachi},
+  {"freeze", tfreeze},
   {"getn", getn},
   {"maxn", maxn},
   {"insert", tinsert},
+  {"move", tmove},
+  {"new", tnew},
   {"remove", tremove},
   {"setn", setn},
   {"sort", sort},
@@ -286,7 +335,6 @@ static const luaL_Reg tab_funcs[] = {
 }
 */
 LUALIB_API int luaopen_table (lua_State *L) {
-  printf("debug: 3.luaopen_table\n");
   luaL_register(L, LUA_TABLIBNAME, tab_funcs); //LUA_TABLIBNAME = "table"
   return 1;
 }
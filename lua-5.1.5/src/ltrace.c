@@ -0,0 +1,146 @@
+/*
+** $Id: ltrace.c $
+** Trace facility (compiled in only with LUAI_TRACE)
+** See Copyright Notice in lua.h
+*/
+
+
+#define ltrace_c
+#define LUA_CORE
+
+#include <string.h>
+
+#include "lua.h"
+
+#include "lopcodes.h"
+#include "lstate.h"
+#include "ltrace.h"
+
+
+
+#if defined(LUAI_TRACE)
+
+void luaR_init (lua_State *L) {
+  TraceRing *tr = &G(L)->trace;
+  tr->head = tr->tail = 0;
+  tr->mask = 0;
+  tr->lastop = OP_RETURN;
+  memset(tr->pairs, 0, sizeof(tr->pairs));
+}
+
+
+/*
+** a full buffer drops the new record: overwriting the oldest one would
+** race with a reader that is copying it out
+*/
+void luaR_record (lua_State *L, int cat, const char *what,
+                  int arg1, int arg2) {
+  TraceRing *tr = &G(L)->trace;
+  lu_int32 h = tr->head;
+  lua_TraceRecord *r;
+  if (h - tr->tail >= LUAI_TRACESIZE) return;  /* buffer full */
+  r = &tr->rec[h & (LUAI_TRACESIZE - 1)];
+  r->cat = cat;
+  r->what = what;
+  r->arg1 = arg1;
+  r->arg2 = arg2;
+  luai_tracefence();  /* record must be visible before the new `head' */
+  tr->head = h + 1;
+}
+
+
+/*
+** pairs are counted on generic opcodes, so that quickened and fused
+** instructions count as what the compiler emitted
+*/
+void luaR_countpair (lua_State *L, OpCode o) {
+  TraceRing *tr = &G(L)->trace;
+  o = genericop(o);
+  tr->pairs[tr->lastop][o]++;
+  tr->lastop = o;
+}
+
+
+LUA_API int lua_settracemask (lua_State *L, int mask) {
+  int old = G(L)->trace.mask;
+  G(L)->trace.mask = mask;
+  return old;
+}
+
+
+LUA_API int lua_gettracemask (lua_State *L) {
+  return G(L)->trace.mask;
+}
+
+
+LUA_API void lua_trace (lua_State *L, int cat, const char *what,
+                        int arg1, int arg2) {
+  luaR_trace(L, cat, what, arg1, arg2);
+}
+
+
+/*
+** copy the oldest record into `r'; returns 0 when the buffer is empty
+*/
+LUA_API int lua_readtrace (lua_State *L, lua_TraceRecord *r) {
+  TraceRing *tr = &G(L)->trace;
+  lu_int32 t = tr->tail;
+  if (t == tr->head) return 0;  /* empty */
+  luai_tracefence();  /* do not read the record before seeing `head' */
+  *r = tr->rec[t & (LUAI_TRACESIZE - 1)];
+  luai_tracefence();  /* finish the copy before releasing the slot */
+  tr->tail = t + 1;
+  return 1;
+}
+
+
+/*
+** get the names and dispatch count of the `n'-th opcode pair (see
+** LUA_TRACEPAIRS); returns 0 when there is no such pair
+*/
+LUA_API int lua_getoppair (lua_State *L, int n, const char **op1,
+                           const char **op2, lua_Number *count) {
+  TraceRing *tr = &G(L)->trace;
+  if (n < 0 || n >= NUM_OPCODES*NUM_OPCODES) return 0;
+  *op1 = luaP_opnames[n / NUM_OPCODES];
+  *op2 = luaP_opnames[n % NUM_OPCODES];
+  *count = cast_num(tr->pairs[n / NUM_OPCODES][n % NUM_OPCODES]);
+  return 1;
+}
+
+
+#else
+
+
+LUA_API int lua_settracemask (lua_State *L, int mask) {
+  UNUSED(L); UNUSED(mask);
+  return 0;
+}
+
+
+LUA_API int lua_gettracemask (lua_State *L) {
+  UNUSED(L);
+  return 0;
+}
+
+
+LUA_API void lua_trace (lua_State *L, int cat, const char *what,
+                        int arg1, int arg2) {
+  UNUSED(L); UNUSED(cat); UNUSED(what); UNUSED(arg1); UNUSED(arg2);
+}
+
+
+LUA_API int lua_readtrace (lua_State *L, lua_TraceRecord *r) {
+  UNUSED(L); UNUSED(r);
+  return 0;
+}
+
+
+LUA_API int lua_getoppair (lua_State *L, int n, const char **op1,
+                           const char **op2, lua_Number *count) {
+  UNUSED(L); UNUSED(n); UNUSED(op1); UNUSED(op2); UNUSED(count);
+  return 0;
+}
+
+#endif
+
@@ -0,0 +1,53 @@
+/*
+** $Id: ltrace.h $
+** Trace facility (compiled in only with LUAI_TRACE)
+** See Copyright Notice in lua.h
+*/
+
+#ifndef ltrace_h
+#define ltrace_h
+
+
+#include "llimits.h"
+#include "lopcodes.h"
+#include "lua.h"
+
+
+#if defined(LUAI_TRACE)
+
+/*
+** single-producer ring buffer; the interpreter only advances `head' and
+** the reader only advances `tail', so neither side needs a lock
+*/
+typedef struct TraceRing {
+  lua_TraceRecord rec[LUAI_TRACESIZE];
+  volatile lu_int32 head;  /* next slot to be written */
+  volatile lu_int32 tail;  /* next slot to be read */
+  int mask;  /* categories being recorded */
+  int lastop;  /* opcode dispatched before the current one */
+  lu_mem pairs[NUM_OPCODES][NUM_OPCODES];  /* dispatch counts of op pairs */
+} TraceRing;
+
+
+#define luaR_trace(L,c,w,a1,a2) \
+	{ if (G(L)->trace.mask & (1 << (c))) luaR_record(L,c,w,a1,a2); }
+
+#define luaR_pair(L,o) \
+	{ if (G(L)->trace.mask & LUA_TMASKPAIRS) luaR_countpair(L,o); }
+
+LUAI_FUNC void luaR_init (lua_State *L);
+LUAI_FUNC void luaR_record (lua_State *L, int cat, const char *what,
+                            int arg1, int arg2);
+LUAI_FUNC void luaR_countpair (lua_State *L, OpCode o);
+
+#else
+
+#define luaR_trace(L,c,w,a1,a2)	((void)0)
+#define luaR_pair(L,o)		((void)0)
+
+#define luaR_init(L)		((void)0)
+
+#endif
+
+
+#endif
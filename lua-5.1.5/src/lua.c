@@ -62,6 +62,47 @@ static void l_message (const char *pname, const char *msg) {
 }
 
 
+#if defined(LUAI_TRACE)
+
+/*
+** trace categories are taken from the LUA_TRACE environment variable;
+** records are drained to stderr after each chunk runs
+*/
+static void opentrace (lua_State *L) {
+  const char *mask = getenv("LUA_TRACE");
+  if (mask != NULL) lua_settracemask(L, atoi(mask));
+}
+
+
+static void dumptrace (lua_State *L) {
+  lua_TraceRecord r;
+  while (lua_readtrace(L, &r))
+    fprintf(stderr, "trace: [%d] %s %d %d\n", r.cat, r.what, r.arg1, r.arg2);
+  fflush(stderr);
+}
+
+
+/* print the opcode pairs counted so far (sort them with `sort -k4 -n') */
+static void dumppairs (lua_State *L) {
+  const char *op1, *op2;
+  lua_Number n;
+  int i;
+  if (!(lua_gettracemask(L) & LUA_TMASKPAIRS)) return;
+  for (i = 0; lua_getoppair(L, i, &op1, &op2, &n); i++) {
+    if (n > 0)
+      fprintf(stderr, "pair: %s %s " LUA_NUMBER_FMT "\n", op1, op2, n);
+  }
+}
+
+#else
+
+#define opentrace(L)	((void)0)
+#define dumptrace(L)	((void)0)
+#define dumppairs(L)	((void)0)
+
+#endif
+
+
 static int report (lua_State *L, int status) {
   if (status && !lua_isnil(L, -1)) {
     const char *msg = lua_tostring(L, -1);
@@ -94,15 +135,16 @@ static int traceback (lua_State *L) {
 
 
 static int docall (lua_State *L, int narg, int clear) {
-  printf("debug: in docall\n");
   int status;
   int base = lua_gettop(L) - narg;  /* function index */
+  luai_apitrace(L, LUA_TRACEPCALL, "docall", narg, clear);
   lua_pushcfunction(L, traceback);  /* push traceback function */
   lua_insert(L, base);  /* put it under chunk and args */
   signal(SIGINT, laction);
   status = lua_pcall(L, narg, (clear ? 0 : LUA_MULTRET), base);
   signal(SIGINT, SIG_DFL);
   lua_remove(L, base);  /* remove traceback function */
+  dumptrace(L);
   /* force a complete garbage collection in case of errors */
   if (status != 0) lua_gc(L, LUA_GCCOLLECT, 0);
   return status;
@@ -133,14 +175,12 @@ static int getargs (lua_State *L, char **argv, int n) {
 
 
 static int dofile (lua_State *L, const char *name) {
-  printf("debug: in dofile\n");
   int status = luaL_loadfile(L, name) || docall(L, 0, 1);
   return report(L, status);
 }
 
 
 static int dostring (lua_State *L, const char *s, const char *name) {
-  printf("debug: in dostring\n");
   int status = luaL_loadbuffer(L, s, strlen(s), name) || docall(L, 0, 1);
   return report(L, status);
 }
@@ -324,9 +364,7 @@ static int runargs (lua_State *L, char **argv, int n) {
 
 
 static int handle_luainit (lua_State *L) {
-  printf("debug: in handle_luainit\n");
   const char *init = getenv(LUA_INIT); /* getenv()用来取得参数envvar环境变量的内容。参数envvar为环境变量的名称，如果该变量存在则会返回指向该内容的指针。环境变量的格式为envvar=value */
-  printf("debug: init = %s\n", init);
   if (init == NULL) return 0;  /* status OK */
   else if (init[0] == '@')
     return dofile(L, init+1);
@@ -343,7 +381,6 @@ struct Smain {
 
 
 static int pmain (lua_State *L) {
-  printf("debug: in pmain\n");
   struct Smain *s = (struct Smain *)lua_touserdata(L, 1); /* L->base + (1-1) */
   char **argv = s->argv;
   int script;
@@ -355,14 +392,7 @@ static int pmain (lua_State *L) {
   lua_gc(L, LUA_GCRESTART, 0);
   s->status = handle_luainit(L);
   if (s->status != 0) return 0;
-  printf("debug: argc = %d\n", s->argc);
-  for(int i = 1; i < s->argc; ++i)
-  {
-    printf("debug: argv[%d] = %s\n", i, s->argv[i]);
-  }
   script = collectargs(argv, &has_i, &has_v, &has_e);
-  printf("debug: script = %d, has_i = %d, has_v = %d, has_e = %d\n",
-    script, has_i, has_v, has_e);
   if (script < 0) {  /* invalid args? */
     print_usage();
     s->status = 1;
@@ -395,9 +425,12 @@ int main (int argc, char **argv) {
     l_message(argv[0], "cannot create state: not enough memory");
     return EXIT_FAILURE;
   }
+  opentrace(L);
   s.argc = argc;
   s.argv = argv;
   status = lua_cpcall(L, &pmain, &s);
+  dumptrace(L);
+  dumppairs(L);
   report(L, status);
   lua_close(L);
   return (status || s.status) ? EXIT_FAILURE : EXIT_SUCCESS;
@@ -83,6 +83,14 @@ typedef void * (*lua_Alloc) (void *ud, void *ptr, size_t osize, size_t nsize);
 #define LUA_TTHREAD		8
 
 
+/*
+** element kinds of typed arrays
+*/
+#define LUA_ADOUBLE	0
+#define LUA_AINT32	1
+#define LUA_AUINT8	2
+
+
 
 /* minimum Lua stack available to a C function */
 #define LUA_MINSTACK	20
@@ -151,6 +159,8 @@ LUA_API const char     *(lua_tolstring) (lua_State *L, int idx, size_t *len);
 LUA_API size_t          (lua_objlen) (lua_State *L, int idx);
 LUA_API lua_CFunction   (lua_tocfunction) (lua_State *L, int idx);
 LUA_API void	       *(lua_touserdata) (lua_State *L, int idx);
+LUA_API void	       *(lua_totypedarray) (lua_State *L, int idx, int *kind,
+                                            int *n);
 LUA_API lua_State      *(lua_tothread) (lua_State *L, int idx);
 LUA_API const void     *(lua_topointer) (lua_State *L, int idx);
 
@@ -162,6 +172,8 @@ LUA_API void  (lua_pushnil) (lua_State *L);
 LUA_API void  (lua_pushnumber) (lua_State *L, lua_Number n);
 LUA_API void  (lua_pushinteger) (lua_State *L, lua_Integer n);
 LUA_API void  (lua_pushlstring) (lua_State *L, const char *s, size_t l);
+LUA_API void  (lua_pushexternalstring) (lua_State *L, const char *s, size_t l,
+                                        lua_Alloc freef, void *ud);
 LUA_API void  (lua_pushstring) (lua_State *L, const char *s);
 LUA_API const char *(lua_pushvfstring) (lua_State *L, const char *fmt,
                                                       va_list argp);
@@ -181,6 +193,7 @@ LUA_API void  (lua_rawget) (lua_State *L, int idx);
 LUA_API void  (lua_rawgeti) (lua_State *L, int idx, int n);
 LUA_API void  (lua_createtable) (lua_State *L, int narr, int nrec);
 LUA_API void *(lua_newuserdata) (lua_State *L, size_t sz);
+LUA_API void *(lua_newtypedarray) (lua_State *L, int kind, int n);
 LUA_API int   (lua_getmetatable) (lua_State *L, int objindex);
 LUA_API void  (lua_getfenv) (lua_State *L, int idx);
 
@@ -194,6 +207,10 @@ LUA_API void  (lua_rawset) (lua_State *L, int idx);
 LUA_API void  (lua_rawseti) (lua_State *L, int idx, int n);
 LUA_API int   (lua_setmetatable) (lua_State *L, int objindex);
 LUA_API int   (lua_setfenv) (lua_State *L, int idx);
+LUA_API void  (lua_cleartable) (lua_State *L, int idx);
+LUA_API void  (lua_rawmove) (lua_State *L, int idx1, int f, int e, int t,
+                                           int idx2);
+LUA_API void  (lua_freezetable) (lua_State *L, int idx);
 
 
 /*
@@ -238,11 +255,13 @@ LUA_API int (lua_gc) (lua_State *L, int what, int data);
 LUA_API int   (lua_error) (lua_State *L);
 
 LUA_API int   (lua_next) (lua_State *L, int idx);
+LUA_API void  (lua_setnextfunction) (lua_State *L, lua_CFunction f);
 
 LUA_API void  (lua_concat) (lua_State *L, int n);
 
 LUA_API lua_Alloc (lua_getallocf) (lua_State *L, void **ud);
 LUA_API void lua_setallocf (lua_State *L, lua_Alloc f, void *ud);
+LUA_API void lua_accountmem (lua_State *L, size_t osize, size_t nsize);
 
 
 
@@ -362,6 +381,54 @@ struct lua_Debug {
 /* }====================================================================== */
 
 
+/*
+** {======================================================================
+** Trace API (only records anything when built with LUAI_TRACE)
+** =======================================================================
+*/
+
+
+/*
+** Trace categories
+*/
+#define LUA_TRACEDISPATCH	0
+#define LUA_TRACECALL		1
+#define LUA_TRACEPCALL		2
+#define LUA_TRACELIBOPEN	3
+#define LUA_TRACEGC		4
+#define LUA_TRACEPAIRS		5
+
+
+/*
+** Trace masks
+*/
+#define LUA_TMASKDISPATCH	(1 << LUA_TRACEDISPATCH)
+#define LUA_TMASKCALL		(1 << LUA_TRACECALL)
+#define LUA_TMASKPCALL		(1 << LUA_TRACEPCALL)
+#define LUA_TMASKLIBOPEN	(1 << LUA_TRACELIBOPEN)
+#define LUA_TMASKGC		(1 << LUA_TRACEGC)
+#define LUA_TMASKPAIRS		(1 << LUA_TRACEPAIRS)
+
+
+typedef struct lua_TraceRecord {
+  int cat;  /* trace category */
+  const char *what;  /* event name; must outlive the record */
+  int arg1;
+  int arg2;
+} lua_TraceRecord;
+
+
+LUA_API int lua_settracemask (lua_State *L, int mask);
+LUA_API int lua_gettracemask (lua_State *L);
+LUA_API void lua_trace (lua_State *L, int cat, const char *what,
+                        int arg1, int arg2);
+LUA_API int lua_readtrace (lua_State *L, lua_TraceRecord *r);
+LUA_API int lua_getoppair (lua_State *L, int n, const char **op1,
+                           const char **op2, lua_Number *count);
+
+/* }====================================================================== */
+
+
 /******************************************************************************
 * Copyright (C) 1994-2012 Lua.org, PUC-Rio.  All rights reserved.
 *
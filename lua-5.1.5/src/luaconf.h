@@ -382,6 +382,90 @@
 #endif
 
 
+/*
+@@ LUA_USE_JUMPTABLE makes 'luaV_execute' dispatch through a table of
+@* label addresses (the "labels as values" extension of GCC and Clang).
+** CHANGE it (define LUA_NOJUMPTABLE) to fall back to the portable
+** 'switch' dispatch, e.g. to compare both with test/bench.lua.
+*/
+#if defined(__GNUC__) && !defined(LUA_ANSI) && !defined(LUA_NOJUMPTABLE)
+#define LUA_USE_JUMPTABLE
+#endif
+
+
+/*
+@@ LUAI_TRACE compiles in the trace facility (see ltrace.c).
+** CHANGE it (define it) if you want Lua to record dispatch, call, pcall,
+** library-open and GC events, or to count executed opcode pairs (to
+** choose superinstructions). Each category must still be switched on
+** at run time with 'lua_settracemask'; records go to a per-state ring
+** buffer that is drained with 'lua_readtrace'. When LUAI_TRACE is not
+** defined every trace point compiles to nothing.
+@@ LUAI_TRACESIZE is the number of records in the ring buffer.
+** CHANGE it if you need a longer history. It must be a power of 2.
+@@ luai_tracefence orders the record stores before the index store,
+** so that another thread may drain the buffer without a lock.
+*/
+/* #define LUAI_TRACE */
+
+#if defined(LUAI_TRACE)
+#define LUAI_TRACESIZE	1024
+#if defined(__GNUC__)
+#define luai_tracefence()	__sync_synchronize()
+#else
+#define luai_tracefence()	((void)0)
+#endif
+#define luai_apitrace(L,c,w,a1,a2)	lua_trace(L,c,w,a1,a2)
+#else
+#define luai_apitrace(L,c,w,a1,a2)	((void)0)
+#endif
+
+
+/*
+@@ LUAI_INCRHASHSIZE is the size of the hash part of a table from which
+@* it is resized incrementally.
+** CHANGE it if resizing big tables causes too long pauses (lower it) or
+** if you do not want incremental resizes at all (raise it above 2^26).
+@@ LUAI_REHASHSTEP is the number of nodes moved to the new hash part of
+@* a table each time a key is added to it while it is being resized.
+*/
+#define LUAI_INCRHASHSIZE	(1 << 16)
+#define LUAI_REHASHSTEP		32
+
+
+/*
+@@ LUA_SWISSTABLE selects an open-addressing layout for the hash part
+@* of tables.
+** CHANGE it (define it) to replace the chained scatter table with a
+** table probed through one control byte per node, 16 nodes at a time
+** (with SSE2 or NEON when available). Nodes lose their `next' link,
+** so they are also one pointer smaller.
+*/
+/* #define LUA_SWISSTABLE */
+
+
+/*
+@@ LUA_SHAPES keeps the string keys of small hash parts in shared shapes.
+** CHANGE it (define it) to save memory in programs with many tables
+** used as records: tables that get the same string keys in the same
+** order share one vector of keys and keep only their values, so field
+** accesses are cached by slot number.
+@@ LUAI_MAXSHAPE is the number of keys from which a table leaves its
+@* shape for the usual hash part.
+*/
+/* #define LUA_SHAPES */
+#define LUAI_MAXSHAPE		16
+
+
+/*
+@@ LUAI_MAXSHORTLEN is the maximum length of the strings kept in the
+@* string table. Longer strings are not interned: creating one does not
+** look for an equal string, equality compares their contents, and
+** their hash is computed only if they are used as table keys.
+*/
+#define LUAI_MAXSHORTLEN	40
+
+
 /*
 @@ LUAI_BITSINT defines the number of bits in an int.
 ** CHANGE here if Lua cannot automatically detect the number of bits of
@@ -582,6 +666,25 @@ union luai_Cast { double l_d; long l_l; };
 
 #endif
 
+
+/*
+@@ LUA_NANBOX packs each value (TValue) into a single 64-bit word, by
+@* storing everything that is not a number in the payload of a NaN.
+** CHANGE it (define it) to halve the size of stack slots, table slots
+** and constants on 64-bit machines. It needs lua_Number to be a double
+** and every pointer (including light userdata) to fit in 47 bits, as
+** on x86-64 Linux and on most 64-bit systems.
+@@ LUAI_UINT64 is an unsigned integer with exactly 64 bits.
+*/
+/* #define LUA_NANBOX */
+
+#if defined(LUA_NANBOX)
+#if !defined(LUA_NUMBER_DOUBLE)
+#error "LUA_NANBOX needs lua_Number to be a double"
+#endif
+#define LUAI_UINT64	unsigned long long
+#endif
+
 /* }================================================================== */
 
 
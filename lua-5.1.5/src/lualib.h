@@ -33,6 +33,15 @@ LUALIB_API int (luaopen_string) (lua_State *L);
 #define LUA_MATHLIBNAME	"math"
 LUALIB_API int (luaopen_math) (lua_State *L);
 
+#define LUA_BITLIBNAME	"bit"
+LUALIB_API int (luaopen_bit) (lua_State *L);
+
+#define LUA_ARRAYLIBNAME	"array"
+LUALIB_API int (luaopen_array) (lua_State *L);
+
+#define LUA_STRBUFLIBNAME	"strbuf"
+LUALIB_API int (luaopen_strbuf) (lua_State *L);
+
 #define LUA_DBLIBNAME	"debug"
 LUALIB_API int (luaopen_debug) (lua_State *L);
 
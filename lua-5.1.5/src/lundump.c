@@ -11,6 +11,7 @@
 
 #include "lua.h"
 
+#include "lcode.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
@@ -118,6 +119,7 @@ static void LoadConstants(LoadState* S, Proto* f)
 	break;
    case LUA_TNUMBER:
 	setnvalue(o,LoadNumber(S));
+	canonnan(o);
 	break;
    case LUA_TSTRING:
 	setsvalue2n(S->L,o,LoadString(S));
@@ -175,6 +177,8 @@ static Proto* LoadFunction(LoadState* S, TString* p)
  LoadConstants(S,f);
  LoadDebug(S,f);
  IF (!luaG_checkcode(f), "bad code");
+ luaF_newcache(S->L,f);
+ luaK_fuse(f);
  S->L->top--;
  S->L->nCcalls--;
  return f;
@@ -14,6 +14,7 @@
 
 #include "lua.h"
 
+#include "larray.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
@@ -24,6 +25,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "ltrace.h"
 #include "lvm.h"
 
 /* limit for table tag-method chains (to avoid loops) */
@@ -35,6 +37,7 @@ const TValue *luaV_tonumber (const TValue *obj, TValue *n) {
   if (ttisnumber(obj)) return obj;
   if (ttisstring(obj) && luaO_str2d(svalue(obj), &num)) {
     setnvalue(n, num);
+    canonnan(n);
     return n;
   }
   else
@@ -270,6 +273,7 @@ int luaV_equalval (lua_State *L, const TValue *t1, const TValue *t2) {
     case LUA_TNUMBER: return luai_numeq(nvalue(t1), nvalue(t2));
     case LUA_TBOOLEAN: return bvalue(t1) == bvalue(t2);  /* true must be 1 !! */
     case LUA_TLIGHTUSERDATA: return pvalue(t1) == pvalue(t2);
+    case LUA_TSTRING: return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
     case LUA_TUSERDATA: {
       if (uvalue(t1) == uvalue(t2)) return 1;
       tm = get_compTM(L, uvalue(t1)->metatable, uvalue(t2)->metatable,
@@ -341,6 +345,7 @@ static void Arith (lua_State *L, StkId ra, const TValue *rb,
       case TM_UNM: setnvalue(ra, luai_numunm(nb)); break;
       default: lua_assert(0); break;
     }
+    canonnan(ra);
   }
   else if (!call_binTM(L, rb, rc, ra, op))
     luaG_aritherror(L, rb, rc);
@@ -352,7 +357,7 @@ static void Arith (lua_State *L, StkId ra, const TValue *rb,
 ** some macros for common tasks in `luaV_execute'
 */
 
-#define runtime_check(L, c)	{ if (!(c)) break; }
+#define runtime_check(L, c)	{ if (!(c)) vmbreak; }
 /* ISK(x) x是指令的操作数，判断其第8bit位是否为1，如果为1则参数是常量，否则为寄存器值 */
 #define RA(i)	(base+GETARG_A(i))
 /* to be used after possible stack reallocation */
@@ -365,249 +370,423 @@ static void Arith (lua_State *L, StkId ra, const TValue *rb,
 #define KBx(i)	check_exp(getBMode(GET_OPCODE(i)) == OpArgK, k+GETARG_Bx(i))
 
 
-#define dojump(L,pc,i)	{(pc) += (i); luai_threadyield(L);}
+/*
+** line and count hooks are looked at only at safe points: on (re)entry,
+** after anything that may run other code (`Protect', calls) and on
+** jumps, so a hook set by `lua_sethook' (even from a signal handler) is
+** seen at the next one. `updatetrap' records the state of the hooks;
+** while they are off the loop does no per-instruction hook work at all.
+*/
+#if defined(LUA_USE_JUMPTABLE)
+#define updatetrap()	(disp = (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) \
+                                ? hooktab : disptab)
+#else
+#define updatetrap()	(trap = L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT))
+#endif
+
+
+#define dojump(L,pc,i)	{(pc) += (i); luai_threadyield(L); updatetrap();}
+
+
+#define Protect(x)	{ L->savedpc = pc; {x;}; base = L->base; updatetrap(); }
+
+
+/*
+** rewrite the opcode of the instruction being executed (quickening);
+** see the notes in lopcodes.h
+*/
+#define patchop(o)	SET_OPCODE(*cast(Instruction *, pc - 1), o)
+
+
+/*
+** inline cache of a lookup with a string key: the cache slot of the
+** running instruction remembers the node where the key was last found,
+** so a hit costs a bounds check and a key compare.  Checking the key
+** (instead of tracking table layouts) keeps the cache valid across
+** rehashes, node moves and nodes reused by `newkey'.
+*/
+#define cacheslot()	(cl->p->cache + pcRel(pc, cl->p))
+
+/*
+** the `next' function of the base library; OP_TFORLOOP keeps the index
+** of the current element in its cache slot (see `luaH_nextcursor')
+*/
+#define isnextf(L,o) \
+  (ttisfunction(o) && clvalue(o)->c.isC && clvalue(o)->c.f == G(L)->nextf)
+
+#if defined(LUA_SHAPES)
+/*
+** a table with a shape caches the index of the key in its shape, so a
+** hit also holds for every other table sharing the shape
+*/
+#define getcached(t,ts,c) \
+  ((t)->shape != NULL \
+     ? (*(c) < (t)->shape->nkeys && (t)->shape->keys[*(c)] == (ts) \
+          ? &(t)->slots[*(c)] : luaH_getstrslot(t, ts, c)) \
+     : getcachednode(t,ts,c))
+#else
+#define getcached(t,ts,c)	getcachednode(t,ts,c)
+#endif
+
+#define getcachednode(t,ts,c) \
+  (*(c) < sizenode(t) && ttisstring(gkey(gnode(t, *(c)))) && \
+   rawtsvalue(gkey(gnode(t, *(c)))) == (ts) \
+     ? gval(gnode(t, *(c))) : luaH_getstrslot(t, ts, c))
 
 
-#define Protect(x)	{ L->savedpc = pc; {x;}; base = L->base; }
+#define getglobal_op() { \
+        TValue *rb = KBx(i); \
+        const TValue *v; \
+        lua_assert(ttisstring(rb)); \
+        v = getcached(cl->env, rawtsvalue(rb), cacheslot()); \
+        if (!ttisnil(v)) { \
+          setobj2s(L, ra, v); \
+        } \
+        else { \
+          TValue g; \
+          sethvalue(L, &g, cl->env); \
+          Protect(luaV_gettable(L, &g, rb, ra)); \
+        } \
+      }
+
 
+/*
+** `s' gets the slot of numeric key `k' in the array part of table `h',
+** or NULL if `k' is not an integer in [1, sizearray]
+*/
+#define arrayslot(h,k,s) { \
+        int n_; \
+        lua_number2int(n_, k); \
+        s = (cast(unsigned int, n_) - 1u < cast(unsigned int, (h)->sizearray) && \
+             luai_numeq(cast_num(n_), k)) ? &(h)->array[n_-1] : NULL; \
+      }
 
-#define arith_op(op,tm) { \
+
+#define gettable_op() { \
+        TValue *rb = RB(i); \
+        TValue *rc = RKC(i); \
+        const TValue *v; \
+        if (ttistable(rb) && ttisstring(rc) && \
+            !ttisnil(v = getcached(hvalue(rb), rawtsvalue(rc), cacheslot()))) { \
+          setobj2s(L, ra, v); \
+        } \
+        else if (ttistable(rb) && ttisnumber(rc)) { \
+          TValue *s; \
+          arrayslot(hvalue(rb), nvalue(rc), s); \
+          if (s != NULL && !ttisnil(s)) { \
+            setobj2s(L, ra, s); \
+          } \
+          else \
+            Protect(luaV_gettable(L, rb, rc, ra)); \
+        } \
+        else if (!istarray(rb) || !luaN_get(rawuvalue(rb), rc, ra)) \
+          Protect(luaV_gettable(L, rb, rc, ra)); \
+      }
+
+
+#define arith_op(op,tm,qop) { \
         TValue *rb = RKB(i); \
         TValue *rc = RKC(i); \
         if (ttisnumber(rb) && ttisnumber(rc)) { \
           lua_Number nb = nvalue(rb), nc = nvalue(rc); \
           setnvalue(ra, op(nb, nc)); \
+          patchop(qop); \
         } \
         else \
           Protect(Arith(L, ra, rb, rc, tm)); \
       }
 
-static const char instruction_mode[][16] = {
-  "OP_MOVE",
-  "OP_LOADK",
-  "OP_LOADBOOL",
-  "OP_LOADNIL",
-  "OP_GETUPVAL",
-  "OP_GETGLOBAL",
-  "OP_GETTABLE",
-  "OP_SETGLOBAL",
-  "OP_SETUPVAL",
-  "OP_SETTABLE",
-  "OP_NEWTABLE",
-  "OP_SELF",
-  "OP_ADD",
-  "OP_SUB",
-  "OP_MUL",
-  "OP_DIV",
-  "OP_MOD",
-  "OP_POW",
-  "OP_UNM",
-  "OP_NOT",
-  "OP_LEN",
-  "OP_CONCAT",
-  "OP_JMP",
-  "OP_EQ",
-  "OP_LT",
-  "OP_LE",
-  "OP_TEST",
-  "OP_TESTSET",
-  "OP_CALL",
-  "OP_TAILCALL",
-  "OP_RETURN",
-  "OP_FORLOOP",
-  "OP_FORPREP",
-  "OP_TFORLOOP",
-  "OP_SETLIST",
-  "OP_CLOSE",
-  "OP_CLOSURE",
-  "OP_VARARG"
-};
-
-static const char arg_mask[][8] = {
-  "OpArgN",
-  "OpArgU",
-  "OpArgR",
-  "OpArgK"
-};
-
-static void print_instruction(const Instruction i)
-{
-  OpCode opcode = GET_OPCODE(i);
-  enum OpMode opmode = getOpMode(opcode);
-  switch(opmode)
-  {
-    case iABC:
-      printf("debug: 当前执行指令 i = %x, opcode = %s(B:%s, C:%s), argA = %d, argB = %d, argC = %d\n",
-            i,
-            instruction_mode[opcode],
-            arg_mask[getBMode(opcode)],
-            arg_mask[getCMode(opcode)],        
-            GETARG_A(i),
-            GETARG_B(i),
-            GETARG_C(i));
-      break;
-    case iABx:
-      printf("debug: 当前执行指令 i = %x, opcode = %s(Bx:%s), argA = %d, argBx = %d\n",
-            i,
-            instruction_mode[GET_OPCODE(i)],
-            arg_mask[getBMode(opcode)],
-            GETARG_A(i),
-            GETARG_Bx(i));
-      break;
-    case iAsBx:
-      printf("debug: 当前执行指令 i = %x, opcode = %s(sBx:%s), argA = %d, argsBx = %d\n",
-            i,
-            instruction_mode[GET_OPCODE(i)],
-            arg_mask[getBMode(opcode)],
-            GETARG_A(i),
-            GETARG_sBx(i));
-      break;
-  }
+
+#define arith_quick(op,tm,gop) { \
+        TValue *rb = RKB(i); \
+        TValue *rc = RKC(i); \
+        if (ttisnumber(rb) && ttisnumber(rc)) { \
+          lua_Number nb = nvalue(rb), nc = nvalue(rc); \
+          setnvalue(ra, op(nb, nc)); \
+        } \
+        else { \
+          patchop(gop);  /* type miss: back to the generic opcode */ \
+          Protect(Arith(L, ra, rb, rc, tm)); \
+        } \
+      }
+
+
+#define order_op(op,f,qop) { \
+        TValue *rb = RKB(i); \
+        TValue *rc = RKC(i); \
+        if (ttisnumber(rb) && ttisnumber(rc)) { \
+          patchop(qop); \
+          if (op(nvalue(rb), nvalue(rc)) == GETARG_A(i)) \
+            dojump(L, pc, GETARG_sBx(*pc)); \
+        } \
+        else \
+          Protect( \
+            if (f(L, rb, rc) == GETARG_A(i)) \
+              dojump(L, pc, GETARG_sBx(*pc)); \
+          ) \
+        pc++; \
+      }
+
+
+#define order_quick(op,f,gop) { \
+        TValue *rb = RKB(i); \
+        TValue *rc = RKC(i); \
+        if (ttisnumber(rb) && ttisnumber(rc)) { \
+          if (op(nvalue(rb), nvalue(rc)) == GETARG_A(i)) \
+            dojump(L, pc, GETARG_sBx(*pc)); \
+        } \
+        else { \
+          patchop(gop);  /* type miss: back to the generic opcode */ \
+          Protect( \
+            if (f(L, rb, rc) == GETARG_A(i)) \
+              dojump(L, pc, GETARG_sBx(*pc)); \
+          ) \
+        } \
+        pc++; \
+      }
+
+
+/*
+** run the line/count hooks for the instruction just fetched;
+** may return from luaV_execute if a hook yields
+*/
+#define hookexec()	{ \
+  if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) && \
+      (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) { \
+    traceexec(L, pc); \
+    if (L->status == LUA_YIELD) {  /* did hook yield? */ \
+      L->savedpc = pc - 1; \
+      return; \
+    } \
+    base = L->base; \
+    ra = RA(i); \
+  } \
+  updatetrap(); \
+}
+
+
+/*
+** fetch the next instruction; with the jump table the hooks are run by
+** the `L_hook' entry of `hooktab' instead
+*/
+#if defined(LUA_USE_JUMPTABLE)
+#define fetchhook()	((void)0)
+#else
+#define fetchhook()	{ if (trap) hookexec(); }
+#endif
+
+#define vmfetch()	{ \
+  i = *pc++; \
+  /* warning!! several calls may realloc the stack and invalidate `ra' */ \
+  ra = RA(i); \
+  fetchhook(); \
+  luaR_trace(L, LUA_TRACEDISPATCH, luaP_opnames[GET_OPCODE(i)], \
+             cast_int(i), pcRel(pc, cl->p)); \
+  luaR_pair(L, GET_OPCODE(i)); \
+  lua_assert(base == L->base && L->base == L->ci->base); \
+  lua_assert(base <= L->top && L->top <= L->stack + L->stacksize); \
+  lua_assert(L->top == L->ci->top || luaG_checkopenop(i)); \
 }
 
+
+/*
+** with LUA_USE_JUMPTABLE every opcode ends with its own indirect jump
+** to the next handler (`vmbreak'), which the branch predictor can learn
+** per opcode; otherwise all opcodes share the jump of the `switch'.
+** A superinstruction ends with `vmfuse', which goes straight to the
+** handler of the instruction it was fused with.
+*/
+#if defined(LUA_USE_JUMPTABLE)
+#define vmdispatch(o)	goto *disp[o];
+#define vmcase(l)	L_##l:
+#define vmbreak		{ vmfetch(); vmdispatch(GET_OPCODE(i)); }
+#define vmfuse(l)	{ vmfetch(); if (disp != disptab) goto L_hook; goto L_##l; }
+#if defined(__GNUC__) && !defined(__clang__)
+/* GCC's global CSE merges those jumps back into one; see the GCC manual
+** on `-fno-gcse' and computed gotos */
+#define vmattr		__attribute__((optimize("no-gcse")))
+#endif
+#else
+#define vmdispatch(o)	switch(o)
+#define vmcase(l)	case l:
+#define vmbreak		continue
+#define vmfuse(l)	vmbreak
+#endif
+
+#if !defined(vmattr)
+#define vmattr		/* empty */
+#endif
+
 /* 虚拟机循环执行指令 */
-void luaV_execute (lua_State *L, int nexeccalls) {
-  printf("debug: in luaV_execute, 循环执行指令\n");
+vmattr void luaV_execute (lua_State *L, int nexeccalls) {
   LClosure *cl;
   StkId base;
   TValue *k;
   const Instruction *pc;
+#if defined(LUA_USE_JUMPTABLE)
+  static const void *const disptab[] = {  /* same order as OpCode */
+    &&L_OP_MOVE, &&L_OP_LOADK, &&L_OP_LOADBOOL, &&L_OP_LOADNIL,
+    &&L_OP_GETUPVAL, &&L_OP_GETGLOBAL, &&L_OP_GETTABLE, &&L_OP_SETGLOBAL,
+    &&L_OP_SETUPVAL, &&L_OP_SETTABLE, &&L_OP_NEWTABLE, &&L_OP_SELF,
+    &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV, &&L_OP_MOD, &&L_OP_POW,
+    &&L_OP_UNM, &&L_OP_NOT, &&L_OP_LEN, &&L_OP_CONCAT, &&L_OP_JMP,
+    &&L_OP_EQ, &&L_OP_LT, &&L_OP_LE, &&L_OP_TEST, &&L_OP_TESTSET,
+    &&L_OP_CALL, &&L_OP_TAILCALL, &&L_OP_RETURN, &&L_OP_FORLOOP,
+    &&L_OP_FORPREP, &&L_OP_TFORLOOP, &&L_OP_SETLIST, &&L_OP_CLOSE,
+    &&L_OP_CLOSURE, &&L_OP_VARARG, &&L_OP_QADD, &&L_OP_QSUB, &&L_OP_QMUL,
+    &&L_OP_QDIV, &&L_OP_QMOD, &&L_OP_QPOW, &&L_OP_QLT, &&L_OP_QLE,
+    &&L_OP_MOVE_MOVE, &&L_OP_MOVE_CALL, &&L_OP_GETGLOBAL_GETTABLE,
+    &&L_OP_GETTABLE_GETTABLE
+  };
+  static const void *const hooktab[NUM_OPCODES] = {
+    [0 ... NUM_OPCODES-1] = &&L_hook  /* all opcodes run the hooks first */
+  };
+  const void *const *disp;  /* `disptab' or, while hooks are on, `hooktab' */
+  lua_assert(sizeof(disptab)/sizeof(disptab[0]) == NUM_OPCODES);
+#else
+  lu_byte trap;  /* are line/count hooks on? */
+#endif
+  luaR_trace(L, LUA_TRACECALL, "execute", nexeccalls, 0);
  reentry:  /* entry point */
   lua_assert(isLua(L->ci));
   pc = L->savedpc; /* 开始执行点 */
   cl = &clvalue(L->ci->func)->l;
   base = L->base;
   k = cl->p->k; /* k数组 */
+  updatetrap();
   /* main loop of interpreter */
   for (;;) {
-    const Instruction i = *pc++;
+    Instruction i;
     StkId ra;
-    if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) &&
-        (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {
-      traceexec(L, pc);
-      if (L->status == LUA_YIELD) {  /* did hook yield? */
-        L->savedpc = pc - 1;
-        return;
+    vmfetch();
+    vmdispatch (GET_OPCODE(i)) {
+#if defined(LUA_USE_JUMPTABLE)
+      L_hook: {  /* line/count hooks are on */
+        hookexec();
+        goto *disptab[GET_OPCODE(i)];
       }
-      base = L->base;
-    }
-    /* warning!! several calls may realloc the stack and invalidate `ra' */
-    /* #define RA(i) (base+GETARG_A(i)) */
-    ra = RA(i);
-    print_instruction(i);
-    lua_assert(base == L->base && L->base == L->ci->base);
-    lua_assert(base <= L->top && L->top <= L->stack + L->stacksize);
-    lua_assert(L->top == L->ci->top || luaG_checkopenop(i));
-    switch (GET_OPCODE(i)) {
-      case OP_MOVE: {
+#endif
+      vmcase(OP_MOVE) {
         setobjs2s(L, ra, RB(i));
-        continue;
+        vmbreak;
       }
-      case OP_LOADK: {
+      vmcase(OP_LOADK) {
         /* #define KBx(i) check_exp(getBMode(GET_OPCODE(i)) == OpArgK, k+GETARG_Bx(i)) */
         setobj2s(L, ra, KBx(i));
-        continue;
+        vmbreak;
       }
-      case OP_LOADBOOL: {
+      vmcase(OP_LOADBOOL) {
         setbvalue(ra, GETARG_B(i));
         if (GETARG_C(i)) pc++;  /* skip next instruction (if C) */
-        continue;
+        vmbreak;
       }
-      case OP_LOADNIL: {
+      vmcase(OP_LOADNIL) {
         TValue *rb = RB(i);
         do {
           setnilvalue(rb--);
         } while (rb >= ra);
-        continue;
+        vmbreak;
       }
-      case OP_GETUPVAL: {
+      vmcase(OP_GETUPVAL) {
         int b = GETARG_B(i);
         setobj2s(L, ra, cl->upvals[b]->v);
-        continue;
+        vmbreak;
       }
-      case OP_GETGLOBAL: {
-        TValue g;
-        TValue *rb = KBx(i);
-        sethvalue(L, &g, cl->env);
-        lua_assert(ttisstring(rb));
-        Protect(luaV_gettable(L, &g, rb, ra));
-        continue;
+      vmcase(OP_GETGLOBAL) {
+        getglobal_op();
+        vmbreak;
       }
-      case OP_GETTABLE: {
-        Protect(luaV_gettable(L, RB(i), RKC(i), ra));
-        continue;
+      vmcase(OP_GETTABLE) {
+        gettable_op();
+        vmbreak;
       }
-      case OP_SETGLOBAL: {
+      vmcase(OP_SETGLOBAL) {
         TValue g;
         sethvalue(L, &g, cl->env);
         lua_assert(ttisstring(KBx(i)));
         Protect(luaV_settable(L, &g, KBx(i), ra));
-        continue;
+        vmbreak;
       }
-      case OP_SETUPVAL: {
+      vmcase(OP_SETUPVAL) {
         UpVal *uv = cl->upvals[GETARG_B(i)];
         setobj(L, uv->v, ra);
         luaC_barrier(L, uv, ra);
-        continue;
+        vmbreak;
       }
-      case OP_SETTABLE: {
-        Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
-        continue;
+      vmcase(OP_SETTABLE) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttistable(ra) && ttisnumber(rb)) {
+          Table *h = hvalue(ra);
+          TValue *s;
+          arrayslot(h, nvalue(rb), s);
+          if (s != NULL && !h->frozen &&
+              (!ttisnil(s) || h->metatable == NULL)) {  /* no `__newindex'? */
+            setobj2t(L, s, rc);
+            luaC_barriert(L, h, rc);
+          }
+          else
+            Protect(luaV_settable(L, ra, rb, rc));
+        }
+        else if (!istarray(ra) || !luaN_set(rawuvalue(ra), rb, rc))
+          Protect(luaV_settable(L, ra, rb, rc));
+        vmbreak;
       }
-      case OP_NEWTABLE: {
+      vmcase(OP_NEWTABLE) {
         int b = GETARG_B(i);
         int c = GETARG_C(i);
         sethvalue(L, ra, luaH_new(L, luaO_fb2int(b), luaO_fb2int(c)));
         Protect(luaC_checkGC(L));
-        continue;
+        vmbreak;
       }
-      case OP_SELF: {
+      vmcase(OP_SELF) {
         StkId rb = RB(i);
         setobjs2s(L, ra+1, rb);
         Protect(luaV_gettable(L, rb, RKC(i), ra));
-        continue;
+        vmbreak;
       }
-      case OP_ADD: {
-        arith_op(luai_numadd, TM_ADD);
-        continue;
+      vmcase(OP_ADD) {
+        arith_op(luai_numadd, TM_ADD, OP_QADD);
+        vmbreak;
       }
-      case OP_SUB: {
-        arith_op(luai_numsub, TM_SUB);
-        continue;
+      vmcase(OP_SUB) {
+        arith_op(luai_numsub, TM_SUB, OP_QSUB);
+        vmbreak;
       }
-      case OP_MUL: {
-        arith_op(luai_nummul, TM_MUL);
-        continue;
+      vmcase(OP_MUL) {
+        arith_op(luai_nummul, TM_MUL, OP_QMUL);
+        vmbreak;
       }
-      case OP_DIV: {
-        arith_op(luai_numdiv, TM_DIV);
-        continue;
+      vmcase(OP_DIV) {
+        arith_op(luai_numdiv, TM_DIV, OP_QDIV);
+        vmbreak;
       }
-      case OP_MOD: {
-        arith_op(luai_nummod, TM_MOD);
-        continue;
+      vmcase(OP_MOD) {
+        arith_op(luai_nummod, TM_MOD, OP_QMOD);
+        vmbreak;
       }
-      case OP_POW: {
-        arith_op(luai_numpow, TM_POW);
-        continue;
+      vmcase(OP_POW) {
+        arith_op(luai_numpow, TM_POW, OP_QPOW);
+        vmbreak;
       }
-      case OP_UNM: {
+      vmcase(OP_UNM) {
         TValue *rb = RB(i);
         if (ttisnumber(rb)) {
           lua_Number nb = nvalue(rb);
           setnvalue(ra, luai_numunm(nb));
+          canonnan(ra);  /* a NaN operand keeps its payload */
         }
         else {
           Protect(Arith(L, ra, rb, rb, TM_UNM));
         }
-        continue;
+        vmbreak;
       }
-      case OP_NOT: {
+      vmcase(OP_NOT) {
         int res = l_isfalse(RB(i));  /* next assignment may change this value */
         setbvalue(ra, res);
-        continue;
+        vmbreak;
       }
-      case OP_LEN: {
+      vmcase(OP_LEN) {
         const TValue *rb = RB(i);
         switch (ttype(rb)) {
           case LUA_TTABLE: {
@@ -618,6 +797,13 @@ void luaV_execute (lua_State *L, int nexeccalls) {
             setnvalue(ra, cast_num(tsvalue(rb)->len));
             break;
           }
+          case LUA_TUSERDATA: {
+            if (istarray(rb)) {
+              setnvalue(ra, cast_num(tarrayof(rawuvalue(rb))->a.size));
+              break;
+            }
+            /* else go through */
+          }
           default: {  /* try metamethod */
             Protect(
               if (!call_binTM(L, rb, luaO_nilobject, ra, TM_LEN))
@@ -625,20 +811,20 @@ void luaV_execute (lua_State *L, int nexeccalls) {
             )
           }
         }
-        continue;
+        vmbreak;
       }
-      case OP_CONCAT: {
+      vmcase(OP_CONCAT) {
         int b = GETARG_B(i);
         int c = GETARG_C(i);
         Protect(luaV_concat(L, c-b+1, c); luaC_checkGC(L));
         setobjs2s(L, RA(i), base+b);
-        continue;
+        vmbreak;
       }
-      case OP_JMP: {
+      vmcase(OP_JMP) {
         dojump(L, pc, GETARG_sBx(i));
-        continue;
+        vmbreak;
       }
-      case OP_EQ: {
+      vmcase(OP_EQ) {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
         Protect(
@@ -646,40 +832,32 @@ void luaV_execute (lua_State *L, int nexeccalls) {
             dojump(L, pc, GETARG_sBx(*pc));
         )
         pc++;
-        continue;
+        vmbreak;
       }
-      case OP_LT: {
-        Protect(
-          if (luaV_lessthan(L, RKB(i), RKC(i)) == GETARG_A(i))
-            dojump(L, pc, GETARG_sBx(*pc));
-        )
-        pc++;
-        continue;
+      vmcase(OP_LT) {
+        order_op(luai_numlt, luaV_lessthan, OP_QLT);
+        vmbreak;
       }
-      case OP_LE: {
-        Protect(
-          if (lessequal(L, RKB(i), RKC(i)) == GETARG_A(i))
-            dojump(L, pc, GETARG_sBx(*pc));
-        )
-        pc++;
-        continue;
+      vmcase(OP_LE) {
+        order_op(luai_numle, lessequal, OP_QLE);
+        vmbreak;
       }
-      case OP_TEST: {
+      vmcase(OP_TEST) {
         if (l_isfalse(ra) != GETARG_C(i))
           dojump(L, pc, GETARG_sBx(*pc));
         pc++;
-        continue;
+        vmbreak;
       }
-      case OP_TESTSET: {
+      vmcase(OP_TESTSET) {
         TValue *rb = RB(i);
         if (l_isfalse(rb) != GETARG_C(i)) {
           setobjs2s(L, ra, rb);
           dojump(L, pc, GETARG_sBx(*pc));
         }
         pc++;
-        continue;
+        vmbreak;
       }
-      case OP_CALL: {
+      vmcase(OP_CALL) {
         int b = GETARG_B(i);
         int nresults = GETARG_C(i) - 1;
         if (b != 0) L->top = ra+b;  /* else previous instruction set top */
@@ -693,14 +871,15 @@ void luaV_execute (lua_State *L, int nexeccalls) {
             /* it was a C function (`precall' called it); adjust results */
             if (nresults >= 0) L->top = L->ci->top;
             base = L->base;
-            continue;
+            updatetrap();
+            vmbreak;
           }
           default: {
             return;  /* yield */
           }
         }
       }
-      case OP_TAILCALL: {
+      vmcase(OP_TAILCALL) {
         int b = GETARG_B(i);
         if (b != 0) L->top = ra+b;  /* else previous instruction set top */
         L->savedpc = pc;
@@ -725,14 +904,15 @@ void luaV_execute (lua_State *L, int nexeccalls) {
           }
           case PCRC: {  /* it was a C function (`precall' called it) */
             base = L->base;
-            continue;
+            updatetrap();
+            vmbreak;
           }
           default: {
             return;  /* yield */
           }
         }
       }
-      case OP_RETURN: {
+      vmcase(OP_RETURN) {
         int b = GETARG_B(i);
         if (b != 0) L->top = ra+b-1;
         if (L->openupval) luaF_close(L, base);
@@ -747,7 +927,7 @@ void luaV_execute (lua_State *L, int nexeccalls) {
           goto reentry;
         }
       }
-      case OP_FORLOOP: {
+      vmcase(OP_FORLOOP) {
         lua_Number step = nvalue(ra+2);
         lua_Number idx = luai_numadd(nvalue(ra), step); /* increment index */
         lua_Number limit = nvalue(ra+1);
@@ -757,9 +937,9 @@ void luaV_execute (lua_State *L, int nexeccalls) {
           setnvalue(ra, idx);  /* update internal index... */
           setnvalue(ra+3, idx);  /* ...and external index */
         }
-        continue;
+        vmbreak;
       }
-      case OP_FORPREP: {
+      vmcase(OP_FORPREP) {
         const TValue *init = ra;
         const TValue *plimit = ra+1;
         const TValue *pstep = ra+2;
@@ -772,10 +952,25 @@ void luaV_execute (lua_State *L, int nexeccalls) {
           luaG_runerror(L, LUA_QL("for") " step must be a number");
         setnvalue(ra, luai_numsub(nvalue(ra), nvalue(pstep)));
         dojump(L, pc, GETARG_sBx(i));
-        continue;
+        vmbreak;
       }
-      case OP_TFORLOOP: {
+      vmcase(OP_TFORLOOP) {
         StkId cb = ra + 3;  /* call base */
+        if (isnextf(L, ra) && ttistable(ra+1) &&
+            !(L->hookmask & LUA_MASKCALL)) {  /* `next' over a table? */
+          int more;
+          setobjs2s(L, cb, ra+2);
+          Protect(more = luaH_nextcursor(L, hvalue(ra+1), cb, cacheslot()));
+          if (more) {
+            int c;
+            for (c = GETARG_C(i); c > 2; c--)  /* extra variables are nil */
+              setnilvalue(cb + c - 1);
+            setobjs2s(L, cb-1, cb);  /* save control variable */
+            dojump(L, pc, GETARG_sBx(*pc));  /* jump back */
+          }
+          pc++;
+          vmbreak;
+        }
         setobjs2s(L, cb+2, ra+2);
         setobjs2s(L, cb+1, ra+1);
         setobjs2s(L, cb, ra);
@@ -788,9 +983,9 @@ void luaV_execute (lua_State *L, int nexeccalls) {
           dojump(L, pc, GETARG_sBx(*pc));  /* jump back */
         }
         pc++;
-        continue;
+        vmbreak;
       }
-      case OP_SETLIST: {
+      vmcase(OP_SETLIST) {
         int n = GETARG_B(i);
         int c = GETARG_C(i);
         int last;
@@ -805,18 +1000,19 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         last = ((c-1)*LFIELDS_PER_FLUSH) + n;
         if (last > h->sizearray)  /* needs more space? */
           luaH_resizearray(L, h, last);  /* pre-alloc it at once */
+        h->border = last;  /* likely the length of the new table */
         for (; n > 0; n--) {
           TValue *val = ra+n;
           setobj2t(L, luaH_setnum(L, h, last--), val);
           luaC_barriert(L, h, val);
         }
-        continue;
+        vmbreak;
       }
-      case OP_CLOSE: {
+      vmcase(OP_CLOSE) {
         luaF_close(L, ra);
-        continue;
+        vmbreak;
       }
-      case OP_CLOSURE: {
+      vmcase(OP_CLOSURE) {
         Proto *p;
         Closure *ncl;
         int nup, j;
@@ -834,9 +1030,9 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         }
         setclvalue(L, ra, ncl);
         Protect(luaC_checkGC(L));
-        continue;
+        vmbreak;
       }
-      case OP_VARARG: {
+      vmcase(OP_VARARG) {
         int b = GETARG_B(i) - 1;
         int j;
         CallInfo *ci = L->ci;
@@ -855,7 +1051,55 @@ void luaV_execute (lua_State *L, int nexeccalls) {
             setnilvalue(ra + j);
           }
         }
-        continue;
+        vmbreak;
+      }
+      vmcase(OP_QADD) {
+        arith_quick(luai_numadd, TM_ADD, OP_ADD);
+        vmbreak;
+      }
+      vmcase(OP_QSUB) {
+        arith_quick(luai_numsub, TM_SUB, OP_SUB);
+        vmbreak;
+      }
+      vmcase(OP_QMUL) {
+        arith_quick(luai_nummul, TM_MUL, OP_MUL);
+        vmbreak;
+      }
+      vmcase(OP_QDIV) {
+        arith_quick(luai_numdiv, TM_DIV, OP_DIV);
+        vmbreak;
+      }
+      vmcase(OP_QMOD) {
+        arith_quick(luai_nummod, TM_MOD, OP_MOD);
+        vmbreak;
+      }
+      vmcase(OP_QPOW) {
+        arith_quick(luai_numpow, TM_POW, OP_POW);
+        vmbreak;
+      }
+      vmcase(OP_QLT) {
+        order_quick(luai_numlt, luaV_lessthan, OP_LT);
+        vmbreak;
+      }
+      vmcase(OP_QLE) {
+        order_quick(luai_numle, lessequal, OP_LE);
+        vmbreak;
+      }
+      vmcase(OP_MOVE_MOVE) {
+        setobjs2s(L, ra, RB(i));
+        vmfuse(OP_MOVE);
+      }
+      vmcase(OP_MOVE_CALL) {
+        setobjs2s(L, ra, RB(i));
+        vmfuse(OP_CALL);
+      }
+      vmcase(OP_GETGLOBAL_GETTABLE) {
+        getglobal_op();
+        vmfuse(OP_GETTABLE);
+      }
+      vmcase(OP_GETTABLE_GETTABLE) {
+        gettable_op();
+        vmfuse(OP_GETTABLE);
       }
     }
   }
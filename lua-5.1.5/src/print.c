@@ -88,6 +88,7 @@ static void PrintCode(const Proto* f)
   printf("\t%d\t",pc+1);
   if (line>0) printf("[%d]\t",line); else printf("[-]\t");
   printf("%-9s\t",luaP_opnames[o]);
+  o=genericop(o);		/* operands of a superinstruction are generic */
   switch (getOpMode(o))
   {
    case iABC:
@@ -0,0 +1,33 @@
+-- time fib.lua, sieve.lua and life.lua with their output discarded
+-- typical usage: lua bench.lua [repetitions]
+-- build once normally and once with -DLUA_NOJUMPTABLE to compare the
+-- two dispatch methods of the interpreter loop
+
+local dir = string.match(arg[0], "^(.-)[^/\\]*$")
+local reps = tonumber(arg[1]) or 3
+local function silent() end
+
+-- script, globals it reads, runs per timing
+local cases = {
+  { "fib.lua", { arg = { 30 } }, 1 },
+  { "sieve.lua", { N = 1000 }, 100 },
+  { "life.lua", {}, 1 },
+}
+
+for _, case in ipairs(cases) do
+  local f = assert(loadfile(dir .. case[1]))
+  local best
+  for r = 1, reps do
+    local c = os.clock()
+    for n = 1, case[3] do
+      local env = setmetatable({ print = silent, io = { write = silent } },
+                               { __index = _G })
+      for k, v in pairs(case[2]) do env[k] = v end
+      setfenv(f, env)
+      f()
+    end
+    c = os.clock() - c
+    if best == nil or c < best then best = c end
+  end
+  print(string.format("%-12s%8.3f", case[1], best))
+end
@@ -0,0 +1,20 @@
+-- check that NaNs with any sign and payload stay numbers
+-- mainly for builds with -DLUA_NANBOX, where a NaN could look like a tag
+
+local function isnan(x) return type(x) == "number" and x ~= x end
+
+local p = tonumber("nan(0x3000000001000)")
+if p == nil then print("strtod does not read NaN payloads") return end
+local z = -p
+assert(isnan(p) and isnan(z) and isnan(-z))
+assert(isnan(z + 1) and isnan(1 - z) and isnan(z * 2) and isnan(z / 3))
+assert(isnan(z % 2) and isnan(z ^ 2))
+assert(isnan(-"nan(0x7000000000001)") and isnan("-nan(0x1)" + 0))
+local t = {z, -z}
+assert(isnan(t[1]) and isnan(t[2]))
+if array then
+  local a = array.new(1, "double")
+  a[1] = z
+  assert(isnan(a[1]) and isnan(-a[1]))
+end
+print("NaNs ok")